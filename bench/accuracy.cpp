@@ -0,0 +1,435 @@
+#include "bench_stats.h"
+#include "../src/parallel.h"
+#include "../src/physics.h"
+#include "../src/scenarios.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Accuracy against cost for the approximations a faster step could make:
+// a larger time step, float instead of double math, Plummer softening and a
+// first-order integrator.
+//
+// A reference run integrates the scene's gravity in double precision with
+// leapfrog at a small time step. Every configuration then integrates the
+// same initial conditions to the same end time and is compared with it:
+//
+//   energy drift    largest |E(t) - E(0)| / |E(0)| over the checkpoints
+//   momentum drift  largest |P(t) - P(0)| / sum |p_i(0)| over the checkpoints
+//   position RMS    root mean square distance from the reference at the end
+//
+// plus its wall time (diagnostics excluded). A row is on the Pareto front
+// if no other row is both faster and more accurate on --metric.
+//
+// Force law: the same as computeAcceleration, which sums G m_j / r^2 and
+// divides by the body's own mass. That is gravity between masses m_i m_j
+// acting on an inertial mass of m_i^2, so the conserved energy and
+// momentum below use m_i^2 as the inertial mass. Like computeAcceleration
+// the kernels skip pairs closer than 0.1, which breaks exact conservation
+// for close encounters. Collisions are left out: they are dissipative and
+// random, so no reference could predict them.
+//
+// Usage: accuracy [--scene <name>] [--count <n>] [--seed <s>] [--time <t>]
+//                 [--reference-dt <dt>] [--dts <dt,dt,...>] [--softenings <e,e,...>]
+//                 [--threads <n>] [--metric rms|energy] [--budget <error>] [--out <file>]
+
+enum AccuracyKernel {
+    KernelProduction,       // stepPhysics's own gravity and integration passes (advanceBodies)
+    KernelFloat,
+    KernelDouble
+};
+
+enum AccuracyIntegrator {
+    IntegratorEuler,        // Semi-implicit Euler, as stepPhysics
+    IntegratorLeapfrog      // Kick-drift-kick, second order
+};
+
+static const char* const kernelNames[] = {"production", "float", "double"};
+static const char* const integratorNames[] = {"euler", "leapfrog"};
+
+struct AccuracyConfig {
+    AccuracyKernel kernel = KernelDouble;
+    AccuracyIntegrator integrator = IntegratorLeapfrog;
+    double dt = 0.001;
+    double softening = 0.0;
+};
+
+// Bodies in structure-of-arrays-of-vectors form at precision Real
+template <typename Real>
+struct BodyState {
+    using Vec = glm::vec<3, Real, glm::defaultp>;
+    std::vector<Vec> position, velocity, acceleration;
+    std::vector<Real> mass;
+};
+
+// Positions and velocities at double precision, for the diagnostics
+struct Checkpoint {
+    std::vector<glm::dvec3> position, velocity;
+};
+
+template <typename Real>
+static void loadBodies(const BodyList& bodies, BodyState<Real>& state) {
+    using Vec = typename BodyState<Real>::Vec;
+    size_t count = bodies.size();
+    state.position.resize(count);
+    state.velocity.resize(count);
+    state.acceleration.assign(count, Vec(0));
+    state.mass.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        state.position[i] = Vec(bodies[i].position);
+        state.velocity[i] = Vec(bodies[i].velocity);
+        state.mass[i] = (Real)bodies[i].mass;
+    }
+}
+
+template <typename Real>
+static void saveCheckpoint(const BodyState<Real>& state, Checkpoint& checkpoint) {
+    size_t count = state.position.size();
+    checkpoint.position.resize(count);
+    checkpoint.velocity.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        checkpoint.position[i] = glm::dvec3(state.position[i]);
+        checkpoint.velocity[i] = glm::dvec3(state.velocity[i]);
+    }
+}
+
+static void saveCheckpoint(const BodyList& bodies, Checkpoint& checkpoint) {
+    checkpoint.position.resize(bodies.size());
+    checkpoint.velocity.resize(bodies.size());
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        checkpoint.position[i] = glm::dvec3(bodies[i].position);
+        checkpoint.velocity[i] = glm::dvec3(bodies[i].velocity);
+    }
+}
+
+// computeAcceleration's force law at precision Real, with optional softening
+template <typename Real>
+static void computeAccelerations(BodyState<Real>& state, Real softening, unsigned int threadCount) {
+    using Vec = typename BodyState<Real>::Vec;
+    const Real G = (Real)gravitationalConstant;
+    const Real softeningSq = softening * softening;
+    size_t count = state.position.size();
+    parallelFor(0, count, threadCount, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            Vec sum(0);
+            for (size_t j = 0; j < count; ++j) {
+                if (j == i) continue;
+                Vec change = state.position[j] - state.position[i];
+                Real distSq = glm::dot(change, change);
+                if (distSq <= (Real)0.01) continue;
+                Real r2 = distSq + softeningSq;
+                sum += change * (G * state.mass[j] / (r2 * std::sqrt(r2)));
+            }
+            state.acceleration[i] = sum / state.mass[i];
+        }
+    });
+}
+
+template <typename Real>
+static void stepState(BodyState<Real>& state, const AccuracyConfig& config, unsigned int threadCount) {
+    const Real dt = (Real)config.dt;
+    const Real softening = (Real)config.softening;
+    size_t count = state.position.size();
+    if (config.integrator == IntegratorEuler) {
+        computeAccelerations(state, softening, threadCount);
+        for (size_t i = 0; i < count; ++i) {
+            state.velocity[i] += state.acceleration[i] * dt;
+            state.position[i] += state.velocity[i] * dt;
+        }
+        return;
+    }
+    // Accelerations carry over from the previous step's second kick
+    for (size_t i = 0; i < count; ++i) {
+        state.velocity[i] += state.acceleration[i] * (dt * (Real)0.5);
+        state.position[i] += state.velocity[i] * dt;
+    }
+    computeAccelerations(state, softening, threadCount);
+    for (size_t i = 0; i < count; ++i) {
+        state.velocity[i] += state.acceleration[i] * (dt * (Real)0.5);
+    }
+}
+
+struct Conserved {
+    double energy = 0.0;
+    glm::dvec3 momentum = glm::dvec3(0.0);
+    double momentumScale = 0.0;     // Sum of |p_i|, to make momentum drift relative
+};
+
+static Conserved measureConserved(const Checkpoint& checkpoint, const std::vector<double>& mass, double softening) {
+    Conserved conserved;
+    size_t count = mass.size();
+    const double G = gravitationalConstant;
+    for (size_t i = 0; i < count; ++i) {
+        double inertia = mass[i] * mass[i];
+        const glm::dvec3& velocity = checkpoint.velocity[i];
+        conserved.energy += 0.5 * inertia * glm::dot(velocity, velocity);
+        conserved.momentum += inertia * velocity;
+        conserved.momentumScale += inertia * glm::length(velocity);
+        for (size_t j = i + 1; j < count; ++j) {
+            glm::dvec3 change = checkpoint.position[j] - checkpoint.position[i];
+            conserved.energy -= G * mass[i] * mass[j] / std::sqrt(glm::dot(change, change) + softening * softening);
+        }
+    }
+    return conserved;
+}
+
+struct AccuracyResult {
+    AccuracyConfig config;
+    uint64_t steps = 0;
+    double seconds = 0.0;
+    double energyDrift = 0.0;
+    double momentumDrift = 0.0;
+    double positionRms = 0.0;
+    Checkpoint final;
+};
+
+// Integrate `bodies` with `config` to `endTime`, checking the conserved
+// quantities at checkpointCount evenly spaced points along the way
+static AccuracyResult runConfig(const BodyList& initial, const AccuracyConfig& requested,
+                                double endTime, unsigned int threadCount) {
+    const int checkpointCount = 10;
+    AccuracyResult result;
+    result.config = requested;
+    result.steps = std::max<uint64_t>(1, (uint64_t)std::llround(endTime / requested.dt));
+    result.config.dt = endTime / result.steps;     // Land exactly on the end time
+    const AccuracyConfig& config = result.config;
+
+    std::vector<double> mass(initial.size());
+    for (size_t i = 0; i < initial.size(); ++i) mass[i] = initial[i].mass;
+
+    BodyList production;
+    BodyState<float> floatState;
+    BodyState<double> doubleState;
+    Checkpoint checkpoint;
+    auto save = [&] {
+        if (config.kernel == KernelProduction) saveCheckpoint(production, checkpoint);
+        else if (config.kernel == KernelFloat) saveCheckpoint(floatState, checkpoint);
+        else saveCheckpoint(doubleState, checkpoint);
+    };
+    double forceSoftening = config.kernel == KernelProduction ? 0.0 : config.softening;
+
+    if (config.kernel == KernelProduction) {
+        production = initial;
+    } else if (config.kernel == KernelFloat) {
+        loadBodies(initial, floatState);
+        if (config.integrator == IntegratorLeapfrog) computeAccelerations(floatState, (float)config.softening, threadCount);
+    } else {
+        loadBodies(initial, doubleState);
+        if (config.integrator == IntegratorLeapfrog) computeAccelerations(doubleState, config.softening, threadCount);
+    }
+    save();
+    Conserved start = measureConserved(checkpoint, mass, forceSoftening);
+
+    uint64_t step = 0;
+    for (int c = 1; c <= checkpointCount; ++c) {
+        uint64_t until = result.steps * c / checkpointCount;
+        auto timer = BenchClock::now();
+        for (; step < until; ++step) {
+            if (config.kernel == KernelProduction) advanceBodies(production, (float)config.dt, nullptr, nullptr, threadCount);
+            else if (config.kernel == KernelFloat) stepState(floatState, config, threadCount);
+            else stepState(doubleState, config, threadCount);
+        }
+        result.seconds += secondsSince(timer);
+
+        save();
+        Conserved now = measureConserved(checkpoint, mass, forceSoftening);
+        result.energyDrift = std::max(result.energyDrift, std::fabs(now.energy - start.energy) / std::fabs(start.energy));
+        result.momentumDrift = std::max(result.momentumDrift,
+                                        glm::length(now.momentum - start.momentum) / std::max(start.momentumScale, 1e-300));
+    }
+    result.final = checkpoint;
+    return result;
+}
+
+static double positionRms(const Checkpoint& a, const Checkpoint& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.position.size(); ++i) {
+        glm::dvec3 change = a.position[i] - b.position[i];
+        sum += glm::dot(change, change);
+    }
+    return a.position.empty() ? 0.0 : std::sqrt(sum / a.position.size());
+}
+
+static bool parseValueList(const char* text, std::vector<double>& values) {
+    values.clear();
+    std::string list(text);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        std::string entry = list.substr(start, end - start);
+        char* parsed = nullptr;
+        double value = std::strtod(entry.c_str(), &parsed);
+        if (entry.empty() || *parsed != '\0' || value < 0.0) return false;
+        values.push_back(value);
+        start = end + 1;
+    }
+    return !values.empty();
+}
+
+int main(int argc, char** argv) {
+    SceneParams scene;
+    scene.count = 256;
+    const char* sceneName = "plummer";
+    double endTime = 1.0;
+    double referenceDt = 2.5e-4;
+    std::vector<double> dts = {0.001, 0.004, 0.016};
+    std::vector<double> softenings = {0.0, 0.05, 0.2};
+    unsigned int threadCount = hardwareThreadCount();
+    bool energyMetric = false;
+    double budget = -1.0;
+    const char* outPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            sceneName = argv[++i];
+            if (!parseSceneType(sceneName, scene.type)) {
+                std::cerr << "Unknown scene: " << sceneName << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            scene.count = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            scene.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            endTime = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--reference-dt") == 0 && i + 1 < argc) {
+            referenceDt = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--dts") == 0 && i + 1 < argc) {
+            if (!parseValueList(argv[++i], dts)) {
+                std::cerr << "Invalid time step list: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--softenings") == 0 && i + 1 < argc) {
+            if (!parseValueList(argv[++i], softenings)) {
+                std::cerr << "Invalid softening list: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--metric") == 0 && i + 1 < argc) {
+            const char* metric = argv[++i];
+            if (std::strcmp(metric, "rms") != 0 && std::strcmp(metric, "energy") != 0) {
+                std::cerr << "Unknown metric: " << metric << std::endl;
+                return -1;
+            }
+            energyMetric = std::strcmp(metric, "energy") == 0;
+        } else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+            budget = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+    if (scene.count < 2 || endTime <= 0.0 || referenceDt <= 0.0) {
+        std::cerr << "ERROR: Need at least 2 bodies and a positive end time and reference step" << std::endl;
+        return -1;
+    }
+    for (double dt : dts) {
+        if (dt <= 0.0) {
+            std::cerr << "ERROR: Time steps must be positive" << std::endl;
+            return -1;
+        }
+    }
+
+    BodyList initial;
+    generateScene(scene, initial);
+
+    // The reference, and the same at twice its step: their difference is
+    // the floor below which errors against the reference mean nothing
+    AccuracyConfig referenceConfig;
+    referenceConfig.dt = referenceDt;
+    std::fprintf(stderr, "reference: %zu bodies to t=%g, dt %g\n", initial.size(), endTime, referenceDt);
+    AccuracyResult reference = runConfig(initial, referenceConfig, endTime, threadCount);
+    referenceConfig.dt = referenceDt * 2.0;
+    AccuracyResult coarseReference = runConfig(initial, referenceConfig, endTime, threadCount);
+    double referenceFloor = positionRms(reference.final, coarseReference.final);
+    std::fprintf(stderr, "reference floor: position RMS %.3g, energy drift %.3g\n", referenceFloor, reference.energyDrift);
+
+    // Every kernel and integrator at every step and softening; the
+    // production kernel has no softening and only its own integrator
+    std::vector<AccuracyConfig> configs;
+    for (double dt : dts) {
+        AccuracyConfig config;
+        config.kernel = KernelProduction;
+        config.integrator = IntegratorEuler;
+        config.dt = dt;
+        configs.push_back(config);
+        for (int kernel = KernelFloat; kernel <= KernelDouble; ++kernel) {
+            for (int integrator = IntegratorEuler; integrator <= IntegratorLeapfrog; ++integrator) {
+                for (double softening : softenings) {
+                    config.kernel = (AccuracyKernel)kernel;
+                    config.integrator = (AccuracyIntegrator)integrator;
+                    config.softening = softening;
+                    configs.push_back(config);
+                }
+            }
+        }
+    }
+
+    std::vector<AccuracyResult> results;
+    for (const AccuracyConfig& config : configs) {
+        results.push_back(runConfig(initial, config, endTime, threadCount));
+        AccuracyResult& result = results.back();
+        result.positionRms = positionRms(result.final, reference.final);
+        result.final = Checkpoint();
+        std::fprintf(stderr, "%-10s %-8s dt %-8g softening %-6g %8.3f s  rms %.3g  energy %.3g\n",
+                     kernelNames[config.kernel], integratorNames[config.integrator], result.config.dt,
+                     config.softening, result.seconds, result.positionRms, result.energyDrift);
+    }
+
+    // Pareto front over (wall time, error): no other row is at least as
+    // good on both and strictly better on one
+    auto errorOf = [&](const AccuracyResult& result) {
+        return energyMetric ? result.energyDrift : result.positionRms;
+    };
+    std::vector<bool> pareto(results.size(), true);
+    for (size_t i = 0; i < results.size(); ++i) {
+        for (size_t j = 0; j < results.size() && pareto[i]; ++j) {
+            if (i == j) continue;
+            bool noWorse = results[j].seconds <= results[i].seconds && errorOf(results[j]) <= errorOf(results[i]);
+            bool better = results[j].seconds < results[i].seconds || errorOf(results[j]) < errorOf(results[i]);
+            if (noWorse && better) pareto[i] = false;
+        }
+    }
+
+    FILE* out = stdout;
+    if (outPath) {
+        out = std::fopen(outPath, "w");
+        if (!out) {
+            std::cerr << "ERROR: Could not write " << outPath << std::endl;
+            return -1;
+        }
+    }
+    std::fprintf(out, "scene,bodies,end_time,kernel,integrator,dt,softening,steps,seconds,"
+                      "energy_drift,momentum_drift,position_rms,reference_floor,pareto\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const AccuracyResult& result = results[i];
+        std::fprintf(out, "%s,%zu,%g,%s,%s,%g,%g,%llu,%.6f,%.6g,%.6g,%.6g,%.6g,%d\n",
+                     sceneName, initial.size(), endTime, kernelNames[result.config.kernel],
+                     integratorNames[result.config.integrator], result.config.dt, result.config.softening,
+                     (unsigned long long)result.steps, result.seconds, result.energyDrift, result.momentumDrift,
+                     result.positionRms, referenceFloor, pareto[i] ? 1 : 0);
+    }
+    if (out != stdout) std::fclose(out);
+
+    // The cheapest configuration within the error budget
+    if (budget >= 0.0) {
+        const AccuracyResult* cheapest = nullptr;
+        for (const AccuracyResult& result : results) {
+            if (errorOf(result) > budget) continue;
+            if (!cheapest || result.seconds < cheapest->seconds) cheapest = &result;
+        }
+        if (cheapest) {
+            std::fprintf(stderr, "cheapest within %s %g: %s %s dt %g softening %g (%.3f s)\n",
+                         energyMetric ? "energy drift" : "position RMS", budget,
+                         kernelNames[cheapest->config.kernel], integratorNames[cheapest->config.integrator],
+                         cheapest->config.dt, cheapest->config.softening, cheapest->seconds);
+        } else {
+            std::fprintf(stderr, "no configuration is within %s %g\n",
+                         energyMetric ? "energy drift" : "position RMS", budget);
+        }
+    }
+    return 0;
+}
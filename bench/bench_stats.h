@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif !defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+// Timing and statistics shared by the benchmark drivers. Samples are
+// summarized by their median and median absolute deviation, which a few
+// outliers (a page fault, a context switch) cannot drag around the way
+// they drag the mean and standard deviation.
+
+using BenchClock = std::chrono::steady_clock;
+
+inline double secondsSince(BenchClock::time_point start) {
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+struct SampleStats {
+    double median = 0.0;
+    double mad = 0.0;       // Median absolute deviation from the median
+    double min = 0.0;
+    double max = 0.0;
+    size_t count = 0;
+};
+
+inline double medianOf(std::vector<double>& values) {
+    if (values.empty()) return 0.0;
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double upper = values[middle];
+    if (values.size() % 2) return upper;
+    double lower = *std::max_element(values.begin(), values.begin() + middle);
+    return 0.5 * (lower + upper);
+}
+
+inline SampleStats summarizeSamples(std::vector<double> samples) {
+    SampleStats stats;
+    stats.count = samples.size();
+    if (samples.empty()) return stats;
+    stats.min = *std::min_element(samples.begin(), samples.end());
+    stats.max = *std::max_element(samples.begin(), samples.end());
+    stats.median = medianOf(samples);
+    for (double& sample : samples) sample = std::fabs(sample - stats.median);
+    stats.mad = medianOf(samples);
+    return stats;
+}
+
+// Keeps a computed value alive so the compiler cannot drop the work
+template <typename T>
+inline void keepValue(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// Parse "a,b,c" into sizes; false if any entry is not a positive number
+inline bool parseSizeList(const char* text, std::vector<size_t>& sizes) {
+    sizes.clear();
+    std::string list(text);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        size_t value = std::strtoull(list.substr(start, end - start).c_str(), nullptr, 10);
+        if (value == 0) return false;
+        sizes.push_back(value);
+        start = end + 1;
+    }
+    return !sizes.empty();
+}
+
+// Peak resident memory of the process so far in bytes, or 0 if unknown
+inline size_t peakResidentBytes() {
+#if defined(__linux__)
+    FILE* status = std::fopen("/proc/self/status", "r");
+    if (!status) return 0;
+    char line[256];
+    size_t kilobytes = 0;
+    while (std::fgets(line, sizeof(line), status)) {
+        if (std::strncmp(line, "VmHWM:", 6) == 0) {
+            kilobytes = std::strtoull(line + 6, nullptr, 10);
+            break;
+        }
+    }
+    std::fclose(status);
+    return kilobytes * 1024;
+#elif defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return (size_t)usage.ru_maxrss;             // Bytes on macOS
+#else
+    return (size_t)usage.ru_maxrss * 1024;      // Kilobytes elsewhere
+#endif
+#endif
+}
+
+// Restart the peak at the current resident size, so each configuration of
+// a sweep reports its own peak. Only Linux can (writing 5 to clear_refs);
+// elsewhere the peak covers everything run so far.
+inline bool resetPeakResident() {
+#if defined(__linux__)
+    FILE* clearRefs = std::fopen("/proc/self/clear_refs", "w");
+    if (!clearRefs) return false;
+    bool written = std::fputs("5", clearRefs) >= 0;
+    return std::fclose(clearRefs) == 0 && written;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,287 @@
+#include "bench_stats.h"
+#include "../src/mesh_gen.h"
+#include "../src/parallel.h"
+#include "../src/physics.h"
+#include "../src/potential.h"
+#include "../src/render_bodies.h"
+#include "../src/scenarios.h"
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+
+// Microbenchmarks for the CPU hot paths, one (kernel, size) pair at a time.
+//
+// Every benchmark is run a few times to warm caches and the allocator,
+// then sampled `reps` times. Kernels faster than minSampleTime are run in
+// batches and each sample is the batch time divided by its length, so
+// timer resolution does not dominate small sizes. Results go to stdout (or
+// --out) as JSON; progress goes to stderr.
+//
+// Usage: microbench [--filter <text>] [--sizes <n,n,...>] [--reps <n>]
+//                   [--warmup <n>] [--min-sample-ms <ms>] [--out <file>]
+//   --filter  run only benchmarks whose name contains <text>
+//   --sizes   body counts for the physics benchmarks (default 256,1024,4096)
+
+struct Benchmark {
+    std::string name;
+    size_t n = 0;                       // Body count, mesh resolution or grid size
+    double itemsPerRun = 0.0;           // Interactions, bodies or vertices handled per run
+    const char* itemName = "items";
+    std::function<void()> setup;        // Untimed, before every sample; forces batches of one
+    std::function<void()> run;
+};
+
+struct BenchmarkOptions {
+    int warmup = 3;
+    int reps = 15;
+    double minSampleTime = 0.002;       // Seconds
+};
+
+struct BenchmarkResult {
+    const Benchmark* benchmark = nullptr;
+    SampleStats seconds;                // Per run
+    int batch = 1;
+};
+
+static BenchmarkResult runBenchmark(const Benchmark& benchmark, const BenchmarkOptions& options) {
+    BenchmarkResult result;
+    result.benchmark = &benchmark;
+
+    // Size the batch from one timed run; kernels that need setup run alone
+    if (benchmark.setup) benchmark.setup();
+    auto start = BenchClock::now();
+    benchmark.run();
+    double once = secondsSince(start);
+    if (!benchmark.setup && once < options.minSampleTime) {
+        result.batch = (int)std::min(1e6, std::ceil(options.minSampleTime / std::max(once, 1e-9)));
+    }
+
+    std::vector<double> samples;
+    for (int rep = -options.warmup; rep < options.reps; ++rep) {
+        if (benchmark.setup) benchmark.setup();
+        start = BenchClock::now();
+        for (int i = 0; i < result.batch; ++i) benchmark.run();
+        double seconds = secondsSince(start) / result.batch;
+        if (rep >= 0) samples.push_back(seconds);
+    }
+    result.seconds = summarizeSamples(samples);
+    return result;
+}
+
+// Scene bodies for the physics kernels; the same seed every time
+static BodyList makeBodies(SceneType type, size_t count) {
+    SceneParams params;
+    params.type = type;
+    params.count = count;
+    BodyList bodies;
+    generateScene(params, bodies);
+    return bodies;
+}
+
+// Scratch the benchmarks run on, kept alive across samples
+struct BenchmarkData {
+    BodyList initial;
+    BodyList bodies;
+    RenderBodies renderBodies;
+    PotentialTree tree;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+};
+
+static void addPhysicsBenchmarks(std::vector<Benchmark>& benchmarks, std::vector<std::unique_ptr<BenchmarkData>>& data,
+                                 size_t n) {
+    // Force kernel: every body's gravity summed directly, single-threaded
+    data.emplace_back(new BenchmarkData());
+    BenchmarkData* gravity = data.back().get();
+    gravity->bodies = makeBodies(ScenePlummer, n);
+    Benchmark benchmark;
+    benchmark.name = "gravity";
+    benchmark.n = n;
+    benchmark.itemsPerRun = gravityInteractions(n);
+    benchmark.itemName = "interactions";
+    benchmark.run = [gravity] {
+        glm::vec3 total(0.0f);
+        for (const SpherePhysics& body : gravity->bodies) {
+            total += computeAcceleration(body, gravity->bodies);
+        }
+        keepValue(total);
+    };
+    benchmarks.push_back(benchmark);
+
+    // Pairwise collisions on a packed box, restored before every sample
+    // (resolving the contacts changes the state the next pass sees)
+    data.emplace_back(new BenchmarkData());
+    BenchmarkData* collisions = data.back().get();
+    collisions->initial = makeBodies(SceneGranularBox, n);
+    benchmark = Benchmark();
+    benchmark.name = "collisions";
+    benchmark.n = n;
+    benchmark.itemsPerRun = collisionInteractions(n);
+    benchmark.itemName = "pairs";
+    benchmark.setup = [collisions] {
+        collisions->bodies = collisions->initial;
+        std::srand(1);
+    };
+    benchmark.run = [collisions] {
+        BodyList& bodies = collisions->bodies;
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            for (size_t j = i + 1; j < bodies.size(); ++j) {
+                handleCollisions(bodies[i], bodies[j]);
+            }
+        }
+    };
+    benchmarks.push_back(benchmark);
+
+    // A whole step as the simulation thread runs it (gravity threaded from
+    // parallelPhysicsThreshold bodies up)
+    data.emplace_back(new BenchmarkData());
+    BenchmarkData* step = data.back().get();
+    step->initial = makeBodies(ScenePlummer, n);
+    benchmark = Benchmark();
+    benchmark.name = "step";
+    benchmark.n = n;
+    benchmark.itemsPerRun = (double)n;
+    benchmark.itemName = "bodies";
+    benchmark.setup = [step] {
+        step->bodies = step->initial;
+        std::srand(1);
+    };
+    benchmark.run = [step] { stepPhysics(step->bodies, 0.001f); };
+    benchmarks.push_back(benchmark);
+
+    // Octree build over the bodies, the only spatial structure in the tree
+    // (used by the gravity sheet)
+    data.emplace_back(new BenchmarkData());
+    BenchmarkData* tree = data.back().get();
+    gatherRenderBodies(makeBodies(ScenePlummer, n), tree->renderBodies);
+    benchmark = Benchmark();
+    benchmark.name = "octree build";
+    benchmark.n = n;
+    benchmark.itemsPerRun = (double)n;
+    benchmark.itemName = "bodies";
+    benchmark.run = [tree] {
+        buildPotentialTree(tree->renderBodies, tree->tree);
+        keepValue(tree->tree.nodes.size());
+    };
+    benchmarks.push_back(benchmark);
+}
+
+static void addMeshBenchmarks(std::vector<Benchmark>& benchmarks, std::vector<std::unique_ptr<BenchmarkData>>& data) {
+    for (int resolution : {8, 32, 128, 512}) {
+        data.emplace_back(new BenchmarkData());
+        BenchmarkData* mesh = data.back().get();
+        Benchmark benchmark;
+        benchmark.name = "uv sphere";
+        benchmark.n = resolution;
+        generateUVSphere(resolution, resolution, mesh->vertices, mesh->indices);
+        benchmark.itemsPerRun = (double)(mesh->vertices.size() / meshVertexFloats);
+        benchmark.itemName = "vertices";
+        benchmark.run = [mesh, resolution] {
+            generateUVSphere(resolution, resolution, mesh->vertices, mesh->indices);
+            keepValue(mesh->vertices.data());
+        };
+        benchmarks.push_back(benchmark);
+    }
+    for (int level : {3, 5, 7}) {
+        data.emplace_back(new BenchmarkData());
+        BenchmarkData* mesh = data.back().get();
+        Benchmark benchmark;
+        benchmark.name = "icosphere";
+        benchmark.n = level;
+        generateIcosphere(level, mesh->vertices, mesh->indices);
+        benchmark.itemsPerRun = (double)(mesh->vertices.size() / meshVertexFloats);
+        benchmark.itemName = "vertices";
+        benchmark.run = [mesh, level] {
+            generateIcosphere(level, mesh->vertices, mesh->indices);
+            keepValue(mesh->vertices.data());
+        };
+        benchmarks.push_back(benchmark);
+    }
+    for (int size : {20, 100, 500}) {
+        Benchmark benchmark;
+        benchmark.name = "grid";
+        benchmark.n = size;
+        benchmark.itemsPerRun = (double)(generateGridVertices(size, 1.0f).size() / 3);
+        benchmark.itemName = "vertices";
+        benchmark.run = [size] {
+            std::vector<float> lines = generateGridVertices(size, 1.0f);
+            keepValue(lines.data());
+        };
+        benchmarks.push_back(benchmark);
+    }
+}
+
+static void writeResults(FILE* out, const std::vector<BenchmarkResult>& results, const BenchmarkOptions& options) {
+    std::fprintf(out, "{\n  \"context\": {\"hardware_threads\": %u, \"warmup\": %d, \"reps\": %d, \"min_sample_ms\": %g},\n",
+                 hardwareThreadCount(), options.warmup, options.reps, options.minSampleTime * 1e3);
+    std::fprintf(out, "  \"benchmarks\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        const Benchmark& benchmark = *result.benchmark;
+        const SampleStats& stats = result.seconds;
+        std::fprintf(out, "%s\n    {\"name\": \"%s\", \"n\": %zu, \"reps\": %zu, \"batch\": %d, "
+                     "\"median_ns\": %.1f, \"mad_ns\": %.1f, \"min_ns\": %.1f, \"max_ns\": %.1f, "
+                     "\"item\": \"%s\", \"items_per_second\": %.6g}",
+                     i ? "," : "", benchmark.name.c_str(), benchmark.n, stats.count, result.batch,
+                     stats.median * 1e9, stats.mad * 1e9, stats.min * 1e9, stats.max * 1e9,
+                     benchmark.itemName, stats.median > 0.0 ? benchmark.itemsPerRun / stats.median : 0.0);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+    const char* filter = nullptr;
+    const char* outPath = nullptr;
+    std::vector<size_t> sizes = {256, 1024, 4096};
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            if (!parseSizeList(argv[++i], sizes)) {
+                std::cerr << "Invalid size list: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            options.reps = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--min-sample-ms") == 0 && i + 1 < argc) {
+            options.minSampleTime = std::max(0.0, std::atof(argv[++i]) * 1e-3);
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+
+    std::vector<Benchmark> benchmarks;
+    std::vector<std::unique_ptr<BenchmarkData>> data;
+    for (size_t n : sizes) addPhysicsBenchmarks(benchmarks, data, n);
+    addMeshBenchmarks(benchmarks, data);
+
+    std::vector<BenchmarkResult> results;
+    for (const Benchmark& benchmark : benchmarks) {
+        if (filter && benchmark.name.find(filter) == std::string::npos) continue;
+        results.push_back(runBenchmark(benchmark, options));
+        const SampleStats& stats = results.back().seconds;
+        std::fprintf(stderr, "%-14s n=%-8zu median %10.3f us  mad %8.3f us  (%.3g %s/s)\n",
+                     benchmark.name.c_str(), benchmark.n, stats.median * 1e6, stats.mad * 1e6,
+                     stats.median > 0.0 ? benchmark.itemsPerRun / stats.median : 0.0, benchmark.itemName);
+    }
+
+    FILE* out = stdout;
+    if (outPath) {
+        out = std::fopen(outPath, "w");
+        if (!out) {
+            std::cerr << "ERROR: Could not write " << outPath << std::endl;
+            return -1;
+        }
+    }
+    writeResults(out, results, options);
+    if (out != stdout) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "bench_stats.h"
+#include "../src/parallel.h"
+#include "../src/physics.h"
+#include "../src/scenarios.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Strong and weak scaling of the simulation step over body and thread
+// counts, written as CSV for sizing hardware.
+//
+// Strong scaling keeps the body count fixed and adds threads; weak scaling
+// grows the body count with the thread count so the gravity work per
+// thread stays the same (n grows with the square root of the threads,
+// since the direct sum visits n^2 pairs). Every configuration generates
+// its scene, runs one untimed step, then steps until --seconds have passed.
+//
+// The direct sum makes large scenes very slow, so configurations whose
+// step is estimated (from the same thread count at a smaller size) to take
+// longer than --max-step-seconds are skipped with a note on stderr.
+//
+// Usage: scaling [--scene <name>] [--mode strong|weak] [--sizes <n,n,...>]
+//                [--threads <n,n,...>] [--seconds <s>] [--max-step-seconds <s>]
+//                [--out <file>]
+//   --sizes    body counts (weak mode: at one thread); default 1k to 10M
+//   --threads  default 1, 2, 4, ... up to every hardware thread. The step
+//              runs on the shared worker pool, so counts above the hardware
+//              thread count split the work finer but add no threads.
+
+struct ScalingRun {
+    size_t bodies = 0;
+    unsigned int threads = 0;
+    uint64_t steps = 0;
+    double seconds = 0.0;
+    StepTimings total;          // Pass times summed over every step
+    size_t peakBytes = 0;
+};
+
+static ScalingRun runConfiguration(const SceneParams& baseScene, size_t bodyCount, unsigned int threads,
+                                   double minSeconds) {
+    ScalingRun run;
+    run.bodies = bodyCount;
+    run.threads = threads;
+
+    resetPeakResident();
+    SceneParams scene = baseScene;
+    scene.count = bodyCount;
+    BodyList bodies;
+    generateScene(scene, bodies);
+    std::srand(1);
+
+    const float deltaTime = 0.001f;
+    stepPhysics(bodies, deltaTime, nullptr, nullptr, threads);
+
+    auto start = BenchClock::now();
+    while (run.steps == 0 || run.seconds < minSeconds) {
+        StepTimings timings;
+        stepPhysics(bodies, deltaTime, &timings, nullptr, threads);
+        run.total.gravity += timings.gravity;
+        run.total.integrate += timings.integrate;
+        run.total.collisions += timings.collisions;
+        run.steps++;
+        run.seconds = secondsSince(start);
+    }
+    run.peakBytes = peakResidentBytes();
+    return run;
+}
+
+int main(int argc, char** argv) {
+    SceneParams scene;
+    const char* sceneName = "plummer";
+    bool weak = false;
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    std::vector<size_t> threadCounts;
+    double minSeconds = 1.0;
+    double maxStepSeconds = 10.0;
+    const char* outPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            sceneName = argv[++i];
+            if (!parseSceneType(sceneName, scene.type)) {
+                std::cerr << "Unknown scene: " << sceneName << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (std::strcmp(mode, "strong") != 0 && std::strcmp(mode, "weak") != 0) {
+                std::cerr << "Unknown mode: " << mode << std::endl;
+                return -1;
+            }
+            weak = std::strcmp(mode, "weak") == 0;
+        } else if (std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            if (!parseSizeList(argv[++i], sizes)) {
+                std::cerr << "Invalid size list: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            if (!parseSizeList(argv[++i], threadCounts)) {
+                std::cerr << "Invalid thread list: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            minSeconds = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--max-step-seconds") == 0 && i + 1 < argc) {
+            maxStepSeconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+    if (threadCounts.empty()) {
+        unsigned int hardware = hardwareThreadCount();
+        for (unsigned int threads = 1; threads < hardware; threads *= 2) threadCounts.push_back(threads);
+        threadCounts.push_back(hardware);
+    }
+    std::sort(sizes.begin(), sizes.end());
+    std::sort(threadCounts.begin(), threadCounts.end());
+
+    FILE* out = stdout;
+    if (outPath) {
+        out = std::fopen(outPath, "w");
+        if (!out) {
+            std::cerr << "ERROR: Could not write " << outPath << std::endl;
+            return -1;
+        }
+    }
+    std::fprintf(out, "mode,scene,bodies,threads,steps,seconds,steps_per_s,interactions_per_s,"
+                      "gravity_ms,integrate_ms,collisions_ms,speedup,efficiency,state_mb,peak_rss_mb\n");
+
+    // Per thread count, the last measured (bodies, seconds per step), for
+    // estimating the next size before running it
+    std::vector<std::pair<size_t, double>> lastRun(threadCounts.size(), std::make_pair((size_t)0, 0.0));
+
+    for (size_t size : sizes) {
+        // The reference for speedup and efficiency: the fewest threads that
+        // ran at this size (weak mode: at this size's one-thread count)
+        double baseStepSeconds = 0.0;
+        double baseThreads = 0.0;
+        double baseInteractionsPerThread = 0.0;
+
+        for (size_t t = 0; t < threadCounts.size(); ++t) {
+            unsigned int threads = (unsigned int)threadCounts[t];
+            size_t bodyCount = weak ? (size_t)std::llround(size * std::sqrt((double)threads)) : size;
+
+            if (lastRun[t].first > 0) {
+                double growth = (double)bodyCount / lastRun[t].first;
+                double estimate = lastRun[t].second * growth * growth;
+                if (estimate > maxStepSeconds) {
+                    std::fprintf(stderr, "skipping %zu bodies on %u threads: about %.3g s per step "
+                                 "(raise --max-step-seconds)\n", bodyCount, threads, estimate);
+                    continue;
+                }
+            }
+
+            ScalingRun run = runConfiguration(scene, bodyCount, threads, minSeconds);
+            double stepSeconds = run.seconds / run.steps;
+            lastRun[t] = std::make_pair(bodyCount, stepSeconds);
+
+            double interactions = gravityInteractions(bodyCount);
+            if (baseStepSeconds == 0.0) {
+                baseStepSeconds = stepSeconds;
+                baseThreads = threads;
+                baseInteractionsPerThread = interactions / threads;
+            }
+
+            // Strong: time at the base thread count over time here. Weak:
+            // the same, scaled for any difference in work per thread from
+            // rounding the body count.
+            double speedup = baseStepSeconds / stepSeconds;
+            double efficiency = speedup * baseThreads / threads;
+            if (weak) {
+                double workRatio = (interactions / threads) / baseInteractionsPerThread;
+                efficiency = workRatio * baseStepSeconds / stepSeconds;
+                speedup = efficiency * threads / baseThreads;
+            }
+
+            std::fprintf(out, "%s,%s,%zu,%u,%llu,%.4f,%.6g,%.6g,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f,%.2f\n",
+                         weak ? "weak" : "strong", sceneName, bodyCount, threads,
+                         (unsigned long long)run.steps, run.seconds, run.steps / run.seconds,
+                         interactions * run.steps / run.seconds,
+                         run.total.gravity / run.steps, run.total.integrate / run.steps,
+                         run.total.collisions / run.steps, speedup, efficiency,
+                         bodyCount * sizeof(SpherePhysics) / 1048576.0, run.peakBytes / 1048576.0);
+            std::fflush(out);
+            std::fprintf(stderr, "%zu bodies, %u threads: %.3g steps/s, efficiency %.2f\n",
+                         bodyCount, threads, run.steps / run.seconds, efficiency);
+        }
+    }
+
+    if (out != stdout) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include "body_loader.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+static const char bodyFileMagic[8] = {'P', 'S', 'I', 'M', 'B', 'O', 'D', '1'};
+
+// Defaults for fields a body list does not carry
+static const float defaultBounceDamping = 0.9f;
+static const glm::vec3 defaultColor = glm::vec3(1.0f, 1.0f, 1.0f);
+
+static bool isDataLineStart(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+}
+
+static const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+static const char* nextLine(const char* p, const char* end) {
+    const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+// Parse one CSV row into `body`; returns false on a malformed row
+static bool parseBodyRow(const char* p, const char* lineEnd, SpherePhysics& body) {
+    float fields[12];
+    int fieldCount = 0;
+    
+    while (fieldCount < 12) {
+        p = skipBlanks(p, lineEnd);
+        if (p < lineEnd && *p == '+') p++;
+        
+        std::from_chars_result result = std::from_chars(p, lineEnd, fields[fieldCount]);
+        if (result.ec != std::errc()) return false;
+        fieldCount++;
+        
+        p = skipBlanks(result.ptr, lineEnd);
+        if (p == lineEnd) break;
+        if (*p == ',') p++;
+    }
+    if (fieldCount < 8 || skipBlanks(p, lineEnd) != lineEnd) return false;
+    // A color is all three channels or none
+    if (fieldCount == 9 || fieldCount == 10) return false;
+    if (!(fields[6] > 0.0f) || !(fields[7] > 0.0f)) return false;
+    
+    body.position = glm::vec3(fields[0], fields[1], fields[2]);
+    body.velocity = glm::vec3(fields[3], fields[4], fields[5]);
+    body.acceleration = glm::vec3(0.0f, 0.0f, 0.0f);
+    body.mass = fields[6];
+    body.radius = fields[7];
+    body.bounceDamping = defaultBounceDamping;
+    body.color = fieldCount >= 11 ? glm::vec3(fields[8], fields[9], fields[10]) : defaultColor;
+    body.luminosity = fieldCount >= 12 ? fields[11] : 0.0f;
+    return true;
+}
+
+bool loadBodiesCSV(const char* path, BodyList& bodies) {
+    MappedFile file;
+    if (!openMappedFile(file, path)) return false;
+    
+    const char* data = reinterpret_cast<const char*>(file.data);
+    const char* end = data + file.size;
+    unsigned int chunkCount = hardwareThreadCount();
+    
+    // Chunk boundaries start on a line: each split point is moved past the
+    // next newline so no line is shared between two chunks
+    std::vector<const char*> chunkStarts(chunkCount + 1);
+    chunkStarts[0] = data;
+    chunkStarts[chunkCount] = end;
+    for (unsigned int chunk = 1; chunk < chunkCount; ++chunk) {
+        const char* split = data + file.size * chunk / chunkCount;
+        split = split > chunkStarts[chunk - 1] ? nextLine(split - 1, end) : chunkStarts[chunk - 1];
+        chunkStarts[chunk] = split;
+    }
+    
+    // Pass 1: count the data rows in each chunk
+    std::vector<size_t> chunkRows(chunkCount + 1, 0);
+    parallelFor(0, chunkCount, chunkCount, [&](size_t chunkBegin, size_t chunkEnd, unsigned int) {
+        for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+            size_t rows = 0;
+            for (const char* p = chunkStarts[chunk]; p < chunkStarts[chunk + 1]; p = nextLine(p, end)) {
+                const char* first = skipBlanks(p, end);
+                if (first < end && isDataLineStart(*first)) rows++;
+            }
+            chunkRows[chunk + 1] = rows;
+        }
+    });
+    for (unsigned int chunk = 0; chunk < chunkCount; ++chunk) {
+        chunkRows[chunk + 1] += chunkRows[chunk];
+    }
+    
+    // Pass 2: each chunk now knows its first row, so it parses straight into
+    // place (the resize leaves the bodies uninitialized, so every page is
+    // first touched by the thread that parses into it)
+    BodyList loaded(chunkRows[chunkCount]);
+    std::atomic<bool> failed(false);
+    parallelFor(0, chunkCount, chunkCount, [&](size_t chunkBegin, size_t chunkEnd, unsigned int) {
+        for (size_t chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+            size_t row = chunkRows[chunk];
+            for (const char* p = chunkStarts[chunk]; p < chunkStarts[chunk + 1] && !failed; ) {
+                const char* lineEnd = nextLine(p, end);
+                const char* first = skipBlanks(p, lineEnd);
+                if (first < lineEnd && isDataLineStart(*first)) {
+                    const char* contentEnd = lineEnd > first && lineEnd[-1] == '\n' ? lineEnd - 1 : lineEnd;
+                    if (!parseBodyRow(first, contentEnd, loaded[row])) {
+                        if (!failed.exchange(true)) {
+                            std::cerr << "ERROR: Malformed body at data row " << row + 1 << " of " << path << std::endl;
+                        }
+                        break;
+                    }
+                    row++;
+                }
+                p = lineEnd;
+            }
+        }
+    });
+    closeMappedFile(file);
+    
+    if (failed) return false;
+    if (loaded.empty()) {
+        std::cerr << "ERROR: No bodies found in " << path << std::endl;
+        return false;
+    }
+    bodies.swap(loaded);
+    return true;
+}
+
+bool loadBodiesBinary(const char* path, BodyList& bodies) {
+    MappedFile file;
+    if (!openMappedFile(file, path)) return false;
+    
+    BodyFileHeader header;
+    bool valid = file.size >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, file.data, sizeof(header));
+        valid = std::memcmp(header.magic, bodyFileMagic, sizeof(bodyFileMagic)) == 0
+            && header.count > 0
+            && header.count <= (file.size - sizeof(header)) / sizeof(BodyRecord);
+    }
+    if (!valid) {
+        std::cerr << "ERROR: " << path << " is not a valid body file" << std::endl;
+        closeMappedFile(file);
+        return false;
+    }
+    
+    BodyList loaded(header.count);
+    const unsigned char* records = file.data + sizeof(header);
+    std::atomic<bool> failed(false);
+    parallelFor(0, header.count, hardwareThreadCount(), [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end && !failed; ++i) {
+            BodyRecord record;
+            std::memcpy(&record, records + i * sizeof(BodyRecord), sizeof(record));
+            
+            SpherePhysics& body = loaded[i];
+            body.position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+            body.velocity = glm::vec3(record.velocity[0], record.velocity[1], record.velocity[2]);
+            body.acceleration = glm::vec3(0.0f, 0.0f, 0.0f);
+            body.mass = record.mass;
+            body.radius = record.radius;
+            body.bounceDamping = defaultBounceDamping;
+            body.color = glm::vec3(record.color[0], record.color[1], record.color[2]);
+            body.luminosity = 0.0f;
+            
+            if (!(body.mass > 0.0f) || !(body.radius > 0.0f)) {
+                if (!failed.exchange(true)) {
+                    std::cerr << "ERROR: Body " << i + 1 << " of " << path << " has a non-positive mass or radius" << std::endl;
+                }
+                break;
+            }
+        }
+    });
+    closeMappedFile(file);
+    
+    if (failed) return false;
+    bodies.swap(loaded);
+    return true;
+}
+
+bool loadBodies(const char* path, BodyList& bodies) {
+    size_t length = std::strlen(path);
+    bool isText = length >= 4 && (std::strcmp(path + length - 4, ".csv") == 0 || std::strcmp(path + length - 4, ".txt") == 0);
+    return isText ? loadBodiesCSV(path, bodies) : loadBodiesBinary(path, bodies);
+}
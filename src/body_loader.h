@@ -0,0 +1,32 @@
+#pragma once
+
+#include "physics.h"
+#include <cstdint>
+#include <vector>
+
+// CSV body lists have one body per line:
+//   x, y, z, vx, vy, vz, mass, radius [, r, g, b [, luminosity]]
+// Lines that do not start with a number (headers, '#' comments) are skipped.
+// Mass and radius must be positive, in both formats.
+//
+// Binary body lists are a BodyFileHeader followed by `count` BodyRecords.
+struct BodyFileHeader {
+    char magic[8];      // "PSIMBOD1"
+    uint64_t count;
+};
+
+struct BodyRecord {
+    float position[3];
+    float velocity[3];
+    float mass;
+    float radius;
+    float color[3];
+};
+
+// Both loaders map the file and parse it on every hardware thread, writing
+// straight into `bodies` (which is resized once to the final body count)
+bool loadBodiesCSV(const char* path, BodyList& bodies);
+bool loadBodiesBinary(const char* path, BodyList& bodies);
+
+// Picks the CSV loader for *.csv / *.txt and the binary loader otherwise
+bool loadBodies(const char* path, BodyList& bodies);
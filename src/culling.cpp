@@ -0,0 +1,109 @@
+#include "culling.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+void extractFrustumPlanes(const glm::mat4& m, FrustumPlanes& planes) {
+    // glm is column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    for (int i = 0; i < 6; ++i) {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        
+        float a = m[0][3] + sign * m[0][row];
+        float b = m[1][3] + sign * m[1][row];
+        float c = m[2][3] + sign * m[2][row];
+        float d = m[3][3] + sign * m[3][row];
+        float length = std::sqrt(a * a + b * b + c * c);
+        
+        planes.a[i] = a / length;
+        planes.b[i] = b / length;
+        planes.c[i] = c / length;
+        planes.d[i] = d / length;
+    }
+}
+
+static bool sphereVisible(const FrustumPlanes& planes, float x, float y, float z, float r) {
+    for (int i = 0; i < 6; ++i) {
+        if (planes.a[i] * x + planes.b[i] * y + planes.c[i] * z + planes.d[i] < -r) return false;
+    }
+    return true;
+}
+
+// Append base + bit for every set bit of `mask`
+static size_t appendVisible(uint32_t* out, size_t count, uint32_t base, unsigned int mask) {
+    while (mask) {
+#if defined(__GNUC__)
+        unsigned int bit = (unsigned int)__builtin_ctz(mask);
+#else
+        unsigned int bit = 0;
+        while (!(mask & (1u << bit))) bit++;
+#endif
+        out[count++] = base + bit;
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+void cullSpheres(const FrustumPlanes& planes, const RenderBodies& bodies, std::vector<uint32_t>& visible) {
+    size_t total = bodies.size();
+    visible.resize(total);
+    uint32_t* out = visible.data();
+    size_t count = 0;
+    size_t i = 0;
+    
+    const float* xs = bodies.x.data();
+    const float* ys = bodies.y.data();
+    const float* zs = bodies.z.data();
+    const float* rs = bodies.radius.data();
+    
+#if defined(__AVX__)
+    for (; i + 8 <= total; i += 8) {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(rs + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        
+        for (int p = 0; p < 6; ++p) {
+            __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.a[p]), x),
+                                                      _mm256_mul_ps(_mm256_set1_ps(planes.b[p]), y)),
+                                        _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.c[p]), z),
+                                                      _mm256_set1_ps(planes.d[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, negR, _CMP_GE_OQ));
+        }
+        count = appendVisible(out, count, (uint32_t)i, (unsigned int)_mm256_movemask_ps(inside));
+    }
+#elif defined(CULLING_SSE)
+    for (; i + 8 <= total; i += 8) {
+        unsigned int mask = 0;
+        for (int half = 0; half < 2; ++half) {
+            size_t j = i + half * 4;
+            __m128 x = _mm_loadu_ps(xs + j);
+            __m128 y = _mm_loadu_ps(ys + j);
+            __m128 z = _mm_loadu_ps(zs + j);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(rs + j));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            
+            for (int p = 0; p < 6; ++p) {
+                __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.a[p]), x),
+                                                    _mm_mul_ps(_mm_set1_ps(planes.b[p]), y)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.c[p]), z),
+                                                    _mm_set1_ps(planes.d[p])));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negR));
+            }
+            mask |= (unsigned int)_mm_movemask_ps(inside) << (half * 4);
+        }
+        count = appendVisible(out, count, (uint32_t)i, mask);
+    }
+#endif
+    
+    for (; i < total; ++i) {
+        if (sphereVisible(planes, xs[i], ys[i], zs[i], rs[i])) out[count++] = (uint32_t)i;
+    }
+    visible.resize(count);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "../include/glm/glm.hpp"
+#include "render_bodies.h"
+#include <cstdint>
+#include <vector>
+
+// Six normalized planes (left, right, bottom, top, near, far) stored as
+// separate coefficient arrays; a point p is inside plane i when
+// a[i] * p.x + b[i] * p.y + c[i] * p.z + d[i] >= 0
+struct FrustumPlanes {
+    float a[6], b[6], c[6], d[6];
+};
+
+// Gribb-Hartmann plane extraction from projection * view
+void extractFrustumPlanes(const glm::mat4& viewProjection, FrustumPlanes& planes);
+
+// Write the indices of every body whose bounding sphere touches the frustum
+// to `visible`, in ascending order. Bodies are tested 8 at a time (AVX when
+// compiled with it, otherwise two SSE halves), with a scalar tail.
+void cullSpheres(const FrustumPlanes& planes, const RenderBodies& bodies, std::vector<uint32_t>& visible);
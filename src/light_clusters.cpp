@@ -0,0 +1,186 @@
+#include "light_clusters.h"
+#include "tracer.h"
+#include <algorithm>
+#include <cmath>
+
+static void createBufferTexture(unsigned int& buffer, unsigned int& texture, GLenum format) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+void createLightClusters(LightClusters& clusters) {
+    createBufferTexture(clusters.gridBuffer, clusters.gridTexture, GL_RG32UI);
+    createBufferTexture(clusters.indexBuffer, clusters.indexTexture, GL_R16UI);
+    createBufferTexture(clusters.lightBuffer, clusters.lightTexture, GL_RGBA32F);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void destroyLightClusters(LightClusters& clusters) {
+    unsigned int buffers[3] = {clusters.gridBuffer, clusters.indexBuffer, clusters.lightBuffer};
+    unsigned int textures[3] = {clusters.gridTexture, clusters.indexTexture, clusters.lightTexture};
+    glDeleteBuffers(3, buffers);
+    glDeleteTextures(3, textures);
+    clusters = LightClusters();
+}
+
+// Orphan the buffer and replace its contents; the texture keeps pointing at it
+static size_t uploadBuffer(unsigned int buffer, const void* data, size_t bytes) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, (size_t)16), NULL, GL_STREAM_DRAW);
+    if (bytes > 0) glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+    return bytes;
+}
+
+// Range of tiles covered by [ndcMin, ndcMax], or false if off screen
+static bool tileRange(float ndcMin, float ndcMax, int tiles, int& first, int& last) {
+    if (ndcMax < -1.0f || ndcMin > 1.0f) return false;
+    first = std::max(0, (int)std::floor((ndcMin * 0.5f + 0.5f) * tiles));
+    last = std::min(tiles - 1, (int)std::floor((ndcMax * 0.5f + 0.5f) * tiles));
+    return first <= last;
+}
+
+size_t updateLightClusters(LightClusters& clusters, const RenderBodies& bodies,
+                           const glm::mat4& view, const glm::mat4& projection,
+                           int viewportWidth, int viewportHeight, float farPlane) {
+    TRACE_ZONE("updateLightClusters");
+    float sliceScale = clusterSlices / std::log(farPlane / clusterDepthNear);
+    float sliceBias = -std::log(clusterDepthNear) * sliceScale;
+    clusters.shaderParams = glm::vec4((float)clusterTilesX / std::max(viewportWidth, 1),
+                                      (float)clusterTilesY / std::max(viewportHeight, 1),
+                                      sliceScale, sliceBias);
+    auto sliceOf = [&](float depth) {
+        if (depth <= clusterDepthNear) return 0;
+        return std::min(clusterSlices - 1, (int)(std::log(depth) * sliceScale + sliceBias));
+    };
+
+    // Cull lights against the frustum and find the cluster box each covers,
+    // counting how many lights land in every cluster
+    clusters.lights.clear();
+    clusters.bounds.clear();
+    clusters.counts.assign(clusterCount, 0);
+    size_t emitterCount = std::min(bodies.emitters.size(), maxClusterLights);
+    for (size_t k = 0; k < emitterCount; ++k) {
+        uint32_t i = bodies.emitters[k];
+        float luminosity = bodies.emitterLuminosity[k];
+        float range = std::sqrt(std::max(luminosity / lightCutoff - 1.0f, 0.0f));
+        if (range <= 0.0f) continue;
+
+        glm::vec3 center = glm::vec3(view * glm::vec4(bodies.x[i], bodies.y[i], bodies.z[i], 1.0f));
+        float nearDepth = -center.z - range;
+        float farDepth = -center.z + range;
+        if (farDepth <= 0.0f || nearDepth >= farPlane) continue;
+
+        // Screen bounds of the light's view-space box. A box reaching the
+        // camera plane could project anywhere, so it covers every tile.
+        int x0 = 0, x1 = clusterTilesX - 1, y0 = 0, y1 = clusterTilesY - 1;
+        if (nearDepth > 0.0f) {
+            float xs[2] = {center.x - range, center.x + range};
+            float ys[2] = {center.y - range, center.y + range};
+            float xMin = projection[0][0] * std::min(xs[0] / nearDepth, xs[0] / farDepth);
+            float xMax = projection[0][0] * std::max(xs[1] / nearDepth, xs[1] / farDepth);
+            float yMin = projection[1][1] * std::min(ys[0] / nearDepth, ys[0] / farDepth);
+            float yMax = projection[1][1] * std::max(ys[1] / nearDepth, ys[1] / farDepth);
+            if (!tileRange(xMin, xMax, clusterTilesX, x0, x1)) continue;
+            if (!tileRange(yMin, yMax, clusterTilesY, y0, y1)) continue;
+        }
+        int z0 = sliceOf(nearDepth);
+        int z1 = sliceOf(farDepth);
+
+        glm::vec3 color = bodies.color[i] * luminosity;
+        clusters.lights.push_back(glm::vec4(center, range));
+        clusters.lights.push_back(glm::vec4(color, 0.0f));
+        int box[6] = {x0, x1, y0, y1, z0, z1};
+        clusters.bounds.insert(clusters.bounds.end(), box, box + 6);
+
+        for (int z = z0; z <= z1; ++z) {
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    clusters.counts[(z * clusterTilesY + y) * clusterTilesX + x]++;
+                }
+            }
+        }
+    }
+    clusters.lightCount = clusters.lights.size() / 2;
+
+    // Prefix sum into (first, count) pairs, then scatter the light indices
+    clusters.grid.resize(clusterCount * 2);
+    uint32_t total = 0;
+    for (int c = 0; c < clusterCount; ++c) {
+        clusters.grid[c * 2] = total;
+        clusters.grid[c * 2 + 1] = clusters.counts[c];
+        clusters.counts[c] = total;    // Reused as the write cursor
+        total += clusters.grid[c * 2 + 1];
+    }
+    clusters.indices.resize(total);
+    for (size_t light = 0; light < clusters.lightCount; ++light) {
+        const int* box = &clusters.bounds[light * 6];
+        for (int z = box[4]; z <= box[5]; ++z) {
+            for (int y = box[2]; y <= box[3]; ++y) {
+                for (int x = box[0]; x <= box[1]; ++x) {
+                    clusters.indices[clusters.counts[(z * clusterTilesY + y) * clusterTilesX + x]++] = (uint16_t)light;
+                }
+            }
+        }
+    }
+    clusters.indexCount = total;
+
+    TRACE_ZONE("uploadLightClusters");
+    size_t bytes = 0;
+    bytes += uploadBuffer(clusters.gridBuffer, clusters.grid.data(), clusters.grid.size() * sizeof(uint32_t));
+    bytes += uploadBuffer(clusters.indexBuffer, clusters.indices.data(), clusters.indices.size() * sizeof(uint16_t));
+    bytes += uploadBuffer(clusters.lightBuffer, clusters.lights.data(), clusters.lights.size() * sizeof(glm::vec4));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return bytes;
+}
+
+void bindLightClusters(const LightClusters& clusters) {
+    glActiveTexture(GL_TEXTURE0 + clusterGridUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, clusters.gridTexture);
+    glActiveTexture(GL_TEXTURE0 + clusterIndexUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, clusters.indexTexture);
+    glActiveTexture(GL_TEXTURE0 + clusterLightUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, clusters.lightTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+std::string clusterLightingShaderSource() {
+    // The dimensions come from the constants the CPU bins with
+    std::string source =
+        "    const int clusterTilesX = " + std::to_string(clusterTilesX) + ";\n"
+        "    const int clusterTilesY = " + std::to_string(clusterTilesY) + ";\n"
+        "    const int clusterSlices = " + std::to_string(clusterSlices) + ";\n";
+    source += R"(
+    uniform usamplerBuffer clusterGrid;
+    uniform usamplerBuffer clusterLightIndices;
+    uniform samplerBuffer clusterLights;
+    
+    vec3 clusterLighting(vec3 viewPos, vec3 viewNormal) {
+        ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterParams.xy), ivec2(clusterTilesX - 1, clusterTilesY - 1));
+        int slice = clamp(int(log(max(-viewPos.z, 1e-4)) * clusterParams.z + clusterParams.w), 0, clusterSlices - 1);
+        uvec2 cluster = texelFetch(clusterGrid, (slice * clusterTilesY + tile.y) * clusterTilesX + tile.x).xy;
+        
+        vec3 total = vec3(0.0);
+        for (uint k = 0u; k < cluster.y; ++k) {
+            int light = int(texelFetch(clusterLightIndices, int(cluster.x + k)).r);
+            vec4 positionRange = texelFetch(clusterLights, light * 2);
+            vec3 toLight = positionRange.xyz - viewPos;
+            float distSq = dot(toLight, toLight);
+            float rangeSq = positionRange.w * positionRange.w;
+            if (distSq >= rangeSq) continue;
+            
+            // Inverse square, windowed to reach zero at the light's range
+            float window = 1.0 - (distSq * distSq) / (rangeSq * rangeSq);
+            float attenuation = window * window / (1.0 + distSq);
+            float diffuse = max(dot(viewNormal, toLight * inversesqrt(distSq)), 0.0);
+            total += texelFetch(clusterLights, light * 2 + 1).rgb * diffuse * attenuation;
+        }
+        return total;
+    }
+)";
+    return source;
+}
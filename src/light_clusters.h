@@ -0,0 +1,82 @@
+#pragma once
+
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include "render_bodies.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Clustered forward shading for light-emitting bodies.
+//
+// The view frustum is cut into clusterTilesX x clusterTilesY screen tiles
+// and clusterSlices depth slices (exponentially spaced between
+// clusterDepthNear and the far plane). Every frame the CPU bins each light's
+// sphere of influence into the clusters it overlaps and uploads three
+// buffer textures:
+//
+//   grid     RG32UI  per cluster: first entry in the index list, light count
+//   indices  R16UI   light indices, grouped by cluster
+//   lights   RGBA32F two texels per light: view-space position and range,
+//                    then color scaled by luminosity
+//
+// A fragment finds its cluster from gl_FragCoord and its view depth and
+// loops over only that cluster's lights, so the cost per pixel depends on
+// how many lights reach it rather than on how many exist.
+const int clusterTilesX = 16;
+const int clusterTilesY = 9;
+const int clusterSlices = 24;
+const int clusterCount = clusterTilesX * clusterTilesY * clusterSlices;
+
+// Slice 0 also takes everything nearer than this
+const float clusterDepthNear = 1.0f;
+
+// Lights beyond this many (in body order) are ignored
+const size_t maxClusterLights = 4096;
+
+// A light's range ends where luminosity / (1 + d^2) falls to this
+const float lightCutoff = 0.02f;
+
+// Texture units the lighting shaders sample the clusters from
+const int clusterGridUnit = 3;
+const int clusterIndexUnit = 4;
+const int clusterLightUnit = 5;
+
+struct LightClusters {
+    unsigned int gridBuffer = 0, gridTexture = 0;
+    unsigned int indexBuffer = 0, indexTexture = 0;
+    unsigned int lightBuffer = 0, lightTexture = 0;
+
+    // For the FrameData block: tiles per pixel (x, y), then the slice
+    // scale and bias, slice = log(depth) * scale + bias
+    glm::vec4 shaderParams = glm::vec4(0.0f);
+
+    size_t lightCount = 0;
+    size_t indexCount = 0;
+
+    // Per-frame scratch, kept to avoid reallocating
+    std::vector<uint32_t> grid;
+    std::vector<uint16_t> indices;
+    std::vector<glm::vec4> lights;
+    std::vector<uint32_t> counts;
+    std::vector<int> bounds;        // Per light: tile x/y and slice ranges
+};
+
+void createLightClusters(LightClusters& clusters);
+void destroyLightClusters(LightClusters& clusters);
+
+// Bin every emitter in `bodies` for this view and upload the result.
+// Returns the number of bytes uploaded.
+size_t updateLightClusters(LightClusters& clusters, const RenderBodies& bodies,
+                           const glm::mat4& view, const glm::mat4& projection,
+                           int viewportWidth, int viewportHeight, float farPlane);
+
+// Bind the three buffer textures to their texture units
+void bindLightClusters(const LightClusters& clusters);
+
+// Fragment-stage GLSL that reads the clusters: their sampler uniforms, the
+// grid dimensions above and clusterLighting(viewPos, viewNormal), the
+// diffuse light from the emitters reaching a view-space position. Needs the
+// FrameData block declared before it.
+std::string clusterLightingShaderSource();
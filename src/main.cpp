@@ -5,65 +5,329 @@
 #include "../include/glm/glm.hpp"
 #include "../include/glm/gtc/matrix_transform.hpp"
 #include "../include/glm/gtc/type_ptr.hpp"
+#include "body_loader.h"
+#include "culling.h"
+#include "light_clusters.h"
+#include "mesh_gen.h"
+#include "parallel.h"
+#include "physics.h"
+#include "potential.h"
+#include "profiler.h"
+#include "program_manager.h"
+#include "render_bodies.h"
+#include "render_queue.h"
+#include "scenarios.h"
+#include "shader_program.h"
+#include "sim_thread.h"
+#include "stream_buffer.h"
+#include "text_overlay.h"
+#include "tracer.h"
+#include "trails.h"
+#include "trajectory.h"
+#include "vertex_format.h"
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 #include <vector>
 
-//g++ ./src/main.cpp -o main -I./include -L./lib -lglad -lglfw3 -lopengl32 -lgdi32 -luser32 -lshell32
+//g++ ./src/*.cpp -o main -std=c++17 -O2 -pthread -I./include -L./lib -lglad -lglfw3 -lopengl32 -lgdi32 -luser32 -lshell32
 
 // Vertex Shader source code
+// Spheres are drawn instanced: every instance supplies its own position,
+// radius and color, while the spin (shared by all spheres) is a uniform.
+// A sphere is only ever translated, rotated and uniformly scaled, so the
+// spin rotation itself is the normal matrix; no per-vertex inverse needed.
 const char* vertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec3 aPos;
     layout (location = 1) in vec3 aNormal;
+    layout (location = 2) in vec3 aOffset;
+    layout (location = 3) in float aRadius;
+    layout (location = 4) in vec4 aColor;
     
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
+    uniform mat3 spin;
     
     out vec3 FragPos;
     out vec3 Normal;
+    out vec3 ObjectColor;
+    out float Emission;
     
     void main() {
-        FragPos = vec3(model * vec4(aPos, 1.0));
-        Normal = mat3(transpose(inverse(model))) * aNormal;
+        // model = translate(aOffset) * spin * scale(aRadius)
+        FragPos = aOffset + aRadius * (spin * aPos);
+        Normal = spin * aNormal;
+        ObjectColor = aColor.rgb;
+        Emission = aColor.a;
         gl_Position = projection * view * vec4(FragPos, 1.0);
     }
 )";
 
-// Fragment Shader source code
+// Fragment Shader source code. Like every program it gets FrameData from a
+// prelude; clusterLighting() comes from clusterLightingShaderSource.
 const char* fragmentShaderSource = R"(
     #version 330 core
     out vec4 FragColor;
     
     in vec3 FragPos;
     in vec3 Normal;
-    
-    uniform vec3 lightPos;
-    uniform vec3 viewPos;
-    uniform vec3 lightColor;
-    uniform vec3 objectColor;
+    in vec3 ObjectColor;
+    in float Emission;
     
     void main() {
         // Ambient lighting
         float ambientStrength = 0.1;
-        vec3 ambient = ambientStrength * lightColor;
+        vec3 ambient = ambientStrength * lightColor.rgb;
         
         // Diffuse lighting
         vec3 norm = normalize(Normal);
-        vec3 lightDir = normalize(lightPos - FragPos);
+        vec3 lightDir = normalize(lightPos.xyz - FragPos);
         float diff = max(dot(norm, lightDir), 0.0);
-        vec3 diffuse = diff * lightColor;
+        vec3 diffuse = diff * lightColor.rgb;
         
         // Specular lighting
         float specularStrength = 0.5;
-        vec3 viewDir = normalize(viewPos - FragPos);
+        vec3 viewDir = normalize(cameraPos.xyz - FragPos);
         vec3 reflectDir = reflect(-lightDir, norm);
         float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-        vec3 specular = specularStrength * spec * lightColor;
+        vec3 specular = specularStrength * spec * lightColor.rgb;
+        
+        // Nearby stars, evaluated in view space
+        vec3 emitted = clusterLighting(vec3(view * vec4(FragPos, 1.0)), mat3(view) * norm);
+        
+        // Stars themselves glow at their own color
+        vec3 result = (ambient + diffuse + specular + emitted) * ObjectColor;
+        FragColor = vec4(mix(result, ObjectColor, Emission), 1.0);
+    }
+)";
+
+// Sphere impostors: one camera-facing quad per instance, large enough to
+// cover the sphere's silhouette under perspective. The fragment shader
+// ray-casts the exact sphere, so normals and depth are per pixel.
+const char* impostorVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aCorner;
+    layout (location = 2) in vec3 aOffset;
+    layout (location = 3) in float aRadius;
+    layout (location = 4) in vec4 aColor;
+    
+    out vec3 QuadPos;
+    flat out vec3 Center;
+    flat out float Radius;
+    flat out vec3 ObjectColor;
+    flat out float Emission;
+    flat out vec3 ViewLightPos;
+    
+    void main() {
+        // Everything happens in view space, where the camera is at the origin
+        Center = vec3(view * vec4(aOffset, 1.0));
+        Radius = aRadius;
+        ObjectColor = aColor.rgb;
+        Emission = aColor.a;
+        ViewLightPos = vec3(view * vec4(lightPos.xyz, 1.0));
+        
+        // Quad through the centre, perpendicular to the line of sight. Its
+        // half-size is where the tangent cone from the eye crosses that plane.
+        float dist = length(Center);
+        vec3 forward = Center / max(dist, 1e-6);
+        vec3 right = normalize(abs(forward.y) > 0.99 ? cross(forward, vec3(1.0, 0.0, 0.0)) : cross(forward, vec3(0.0, 1.0, 0.0)));
+        vec3 up = cross(right, forward);
+        float halfSize = aRadius * dist / sqrt(max(dist * dist - aRadius * aRadius, 1e-6));
         
-        vec3 result = (ambient + diffuse + specular) * objectColor;
-        FragColor = vec4(result, 1.0);
+        QuadPos = Center + (right * aCorner.x + up * aCorner.y) * halfSize;
+        gl_Position = projection * vec4(QuadPos, 1.0);
+    }
+)";
+
+const char* impostorFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    in vec3 QuadPos;
+    flat in vec3 Center;
+    flat in float Radius;
+    flat in vec3 ObjectColor;
+    flat in float Emission;
+    flat in vec3 ViewLightPos;
+    
+    void main() {
+        // Intersect the eye ray through this fragment with the sphere
+        vec3 rayDir = normalize(QuadPos);
+        float b = dot(rayDir, Center);
+        float c = dot(Center, Center) - Radius * Radius;
+        float disc = b * b - c;
+        if (disc < 0.0) discard;
+        float t = b - sqrt(disc);
+        if (t <= 0.0) discard;
+        
+        vec3 FragPos = rayDir * t;
+        vec3 norm = (FragPos - Center) / Radius;
+        
+        vec4 clipPos = projection * vec4(FragPos, 1.0);
+        gl_FragDepth = 0.5 * clipPos.z / clipPos.w + 0.5;
+        
+        // Same Phong model as fragmentShaderSource
+        float ambientStrength = 0.1;
+        vec3 ambient = ambientStrength * lightColor.rgb;
+        
+        vec3 lightDir = normalize(ViewLightPos - FragPos);
+        float diff = max(dot(norm, lightDir), 0.0);
+        vec3 diffuse = diff * lightColor.rgb;
+        
+        float specularStrength = 0.5;
+        vec3 viewDir = normalize(-FragPos);
+        vec3 reflectDir = reflect(-lightDir, norm);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+        vec3 specular = specularStrength * spec * lightColor.rgb;
+        
+        vec3 emitted = clusterLighting(FragPos, norm);
+        vec3 result = (ambient + diffuse + specular + emitted) * ObjectColor;
+        FragColor = vec4(mix(result, ObjectColor, Emission), 1.0);
+    }
+)";
+
+// Point splats: one GL_POINTS vertex per body, sized by its projected
+// radius and accumulated additively into a floating-point target.
+// Sub-pixel bodies are clamped to one pixel and dimmed by their covered
+// area, so the accumulated brightness tracks projected density.
+const char* splatVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 2) in vec3 aOffset;
+    layout (location = 3) in float aRadius;
+    layout (location = 4) in vec3 aColor;
+    
+    uniform float pointScale;       // Pixels per unit radius at unit depth
+    uniform float splatIntensity;
+    
+    out vec3 SplatColor;
+    
+    void main() {
+        vec4 viewPos = view * vec4(aOffset, 1.0);
+        gl_Position = projection * viewPos;
+        
+        float pixelRadius = aRadius * pointScale / max(-viewPos.z, 0.001);
+        float size = 2.0 * pixelRadius;
+        gl_PointSize = clamp(size, 1.0, 64.0);
+        
+        float coverage = min(size * size, 1.0);
+        SplatColor = aColor * splatIntensity * coverage;
+    }
+)";
+
+const char* splatFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    in vec3 SplatColor;
+    
+    void main() {
+        vec2 d = gl_PointCoord * 2.0 - 1.0;
+        float r2 = dot(d, d);
+        if (r2 > 1.0) discard;
+        float weight = exp(-4.0 * r2);
+        FragColor = vec4(SplatColor * weight, weight);
+    }
+)";
+
+// Fullscreen triangle that maps the accumulated splat density to display
+// range and adds it over the scene
+const char* tonemapVertexShaderSource = R"(
+    #version 330 core
+    out vec2 TexCoord;
+    
+    void main() {
+        vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        TexCoord = corner;
+        gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    }
+)";
+
+const char* tonemapFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    in vec2 TexCoord;
+    
+    uniform sampler2D density;
+    uniform float exposure;
+    
+    void main() {
+        vec3 hdr = texture(density, TexCoord).rgb;
+        FragColor = vec4(vec3(1.0) - exp(-exposure * hdr), 1.0);
+    }
+)";
+
+// Orbit trails: one line strip per body (the instance), one vertex per
+// history sample walking back from the newest. Samples live in a ring of
+// slots, each slot holding every body's position for one sample time.
+const char* trailVertexShaderSource = R"(
+    #version 330 core
+    uniform samplerBuffer trailPositions;
+    uniform samplerBuffer trailColors;
+    uniform int trailHead;          // Slot holding the newest sample
+    uniform int trailLength;        // Slots in the ring
+    uniform int trailBodyCount;
+    
+    out vec3 TrailColor;
+    
+    void main() {
+        int age = gl_VertexID;
+        int slot = (trailHead - age + trailLength) % trailLength;
+        vec3 position = texelFetch(trailPositions, slot * trailBodyCount + gl_InstanceID).xyz;
+        gl_Position = projection * view * vec4(position, 1.0);
+        
+        // Fade towards the oldest sample
+        float fade = 1.0 - float(age) / float(trailLength);
+        TrailColor = texelFetch(trailColors, gl_InstanceID).rgb * fade * 0.6;
+    }
+)";
+
+const char* trailFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    in vec3 TrailColor;
+    
+    void main() {
+        FragColor = vec4(TrailColor, 1.0);
+    }
+)";
+
+// Gravity sheet: the reference plane sunk by the sampled potential. The
+// XZ layout never changes; only the per-vertex height is streamed.
+const char* sheetVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aXZ;
+    layout (location = 1) in float aPotential;
+    
+    uniform float depthScale;
+    uniform float maxDepth;
+    
+    out vec3 SheetColor;
+    
+    void main() {
+        // Clamped so wells stay on screen
+        float aHeight = max(aPotential * depthScale, -maxDepth);
+        gl_Position = projection * view * vec4(aXZ.x, aHeight, aXZ.y, 1.0);
+        
+        // Dim gray on the flat sheet, brighter blue down the wells
+        float depth = clamp(-aHeight / maxDepth, 0.0, 1.0);
+        SheetColor = mix(vec3(0.3), vec3(0.35, 0.55, 1.0), sqrt(depth));
+    }
+)";
+
+const char* sheetFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    in vec3 SheetColor;
+    
+    void main() {
+        FragColor = vec4(SheetColor, 1.0);
     }
 )";
 
@@ -72,8 +336,6 @@ const char* lineVertexShaderSource = R"(
     layout (location = 0) in vec3 aPos;
     
     uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
     
     void main() {
         gl_Position = projection * view * model * vec4(aPos, 1.0);
@@ -91,53 +353,69 @@ const char* lineFragmentShaderSource = R"(
     }
 )";
 
+// Overlay text: quads in window pixels (origin top-left) sampling the
+// bitmap font atlas, which only holds coverage
+const char* textVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aPos;
+    layout (location = 1) in vec2 aTexCoord;
+    layout (location = 2) in vec4 aColor;
+    
+    uniform vec2 viewportSize;
+    
+    out vec2 TexCoord;
+    out vec4 TextColor;
+    
+    void main() {
+        TexCoord = aTexCoord;
+        TextColor = aColor;
+        gl_Position = vec4(aPos.x / viewportSize.x * 2.0 - 1.0, 1.0 - aPos.y / viewportSize.y * 2.0, 0.0, 1.0);
+    }
+)";
+
+const char* textFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+    
+    in vec2 TexCoord;
+    in vec4 TextColor;
+    
+    uniform sampler2D font;
+    
+    void main() {
+        FragColor = vec4(TextColor.rgb, TextColor.a * texture(font, TexCoord).r);
+    }
+)";
+
 // Global variables for window dimensions and physics
 int windowWidth = 800;
 int windowHeight = 600;
 
-// Physics variables
-struct SpherePhysics {
-    glm::vec3 position;
-    glm::vec3 velocity;
-    glm::vec3 acceleration;
-    float mass;  // Changed from double to float
-    float radius;
-    float bounceDamping;
-    glm::vec3 color;
-};
+// Replay seeking requested from the keyboard, in seconds (applied by the render loop)
+double replaySeekRequest = 0.0;
+bool replayRestartRequest = false;
 
-// Initialize sphere physics
-SpherePhysics sphere = {
-    glm::vec3(3.0f, 2.0f, 0.0f),    // Starting position
-    glm::vec3(-1.0f, -2.0f, 0.0f),  // Initial velocity  
-    glm::vec3(0.0f, 0.0f, 0.0f),    // Gravity acceleration  
-    1.0f,                           // Mass
-    1.0f,                           // Radius
-    0.8f,                           // Bounce damping factor
-    glm::vec3(1.0f, 0.0f, 0.0f)     // color
+// How spheres are drawn; M cycles through the modes
+enum RenderMode {
+    RenderMesh,         // Instanced tessellated sphere mesh
+    RenderImpostor,     // Ray-cast impostor quads
+    RenderSplat,        // Additive point splats, tonemapped
+    RenderModeCount
 };
+RenderMode renderMode = RenderMesh;
 
-SpherePhysics sphere2 = {
-    glm::vec3(-3.0f, 2.0f, 0.0f),   // starting position  
-    glm::vec3(1.0f, 0.0f, -1.0f),   // initial velocity  
-    glm::vec3(0.0f, 0.0f, 0.0f),    // Same gravity  
-    1.0f,                           // mass
-    1.0f,                           // Same radius
-    0.9f,                           // Different bounce damping
-    glm::vec3(0.0f, 0.0f, 1.0f)     // color
-};
+// Orbit trails, toggled with T
+bool showTrails = false;
 
-SpherePhysics sphere3 = {
-    glm::vec3(-3.0f, -2.0f, 0.0f),  // starting position  
-    glm::vec3(0.0f, 2.0f, 2.0f),    // initial velocity  
-    glm::vec3(0.0f, 0.0f, 0.0f),    // Same gravity  
-    1.0f,                           // mass
-    1.0f,                           // Same radius
-    0.9f,                           // Different bounce damping
-    glm::vec3(0.0f, 1.0f, 0.0f)     // color
-};
+// Gravity sheet in place of the flat grid, toggled with G
+bool showGravitySheet = false;
+
+// Per-phase timing overlay, toggled with P
+bool showPerfOverlay = false;
+
+// F12 writes the zones traced so far (tracing builds only)
+bool traceWriteRequest = false;
 
-bool playback = true;
 
 // Resize callback function
 void resizeWindow(GLFWwindow* window, int width, int height) {
@@ -146,223 +424,578 @@ void resizeWindow(GLFWwindow* window, int width, int height) {
     windowHeight = height;
 }
 
-void handleCollisions(SpherePhysics& sphere, SpherePhysics& sphere1){
-    glm::vec3 change1 = sphere1.position - sphere.position;
-    float distance1 = glm::length(change1);
-    float minDistance1 = sphere.radius + sphere1.radius;
+// Point the instance attributes (locations 2-4 of vertexShaderSource) of
+// the bound VAO at this frame's SphereInstance data, which starts `offset`
+// bytes into `instanceVBO`
+void setupSphereInstanceAttributes(unsigned int instanceVBO, size_t offset) {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    
+    GLsizei stride = sizeof(SphereInstance);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(SphereInstance, x)));
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(SphereInstance, radius)));
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(offset + offsetof(SphereInstance, color)));
+    for (unsigned int location = 2; location <= 4; ++location) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+}
 
-    if (distance1 <= minDistance1 && distance1 > 0.01f) {
-        // Collision normal
-        glm::vec3 normal = change1 / distance1;
-        
-        // Separate spheres more aggressively
-        float overlap = minDistance1 - distance1;
-        float separationAmount = overlap * 0.5f + 0.05f; // Increased separation
-        sphere.position -= normal * separationAmount;
-        sphere1.position += normal * separationAmount;
-        
-        // Simple elastic collision (equal mass)
-        glm::vec3 relativeVelocity = sphere1.velocity - sphere.velocity;
-        float velocityAlongNormal = glm::dot(relativeVelocity, normal);
-        
-        if (velocityAlongNormal > 0) return; // Objects separating
-        
-        // Apply collision response
-        float restitution = 0.8f; // Bounciness factor
-        float impulse = -(1 + restitution) * velocityAlongNormal;
-        
-        sphere.velocity += impulse * normal;
-        sphere1.velocity -= impulse * normal;
+inline void writeSphereInstance(SphereInstance& out, const RenderBodies& bodies, uint32_t i) {
+    out.x = bodies.x[i];
+    out.y = bodies.y[i];
+    out.z = bodies.z[i];
+    out.radius = bodies.radius[i];
+    out.color = bodies.packedColor[i];
+}
+
+// Write the visible bodies' instance data straight into the mapped stream
+// buffer. Returns false if the buffer could not be mapped; `offset`
+// receives where the data starts in the buffer.
+bool writeSphereInstances(StreamBuffer& instances, const RenderBodies& bodies,
+                          const std::vector<uint32_t>& visible, size_t& offset) {
+    TRACE_ZONE("writeSphereInstances");
+    SphereInstance* out = static_cast<SphereInstance*>(beginStreamWrite(instances, visible.size() * sizeof(SphereInstance), offset));
+    if (!out) return false;
+    
+    for (uint32_t i : visible) {
+        writeSphereInstance(*out++, bodies, i);
+    }
+    endStreamWrite(instances);
+    return true;
+}
+
+// A sphere mesh at one level of detail. Indices are 16-bit whenever the
+// vertex count allows it, which halves index fetch for every LOD we use.
+struct SphereLOD {
+    unsigned int VAO, VBO, EBO;
+    int indexCount;
+    GLenum indexType;
+    float minPixelRadius;   // Used when the projected radius is at least this many pixels
+};
+
+// Finest to coarsest: 30x30 (1,800 triangles) down to 4x4 (32 triangles)
+const int sphereLODCount = 4;
+const int sphereLODResolutions[sphereLODCount] = {30, 16, 8, 4};
+const float sphereLODMinPixelRadius[sphereLODCount] = {48.0f, 16.0f, 5.0f, 0.0f};
+
+SphereLOD createSphereLOD(int resolution, float minPixelRadius) {
+    SphereLOD lod;
+    lod.minPixelRadius = minPixelRadius;
+    glGenVertexArrays(1, &lod.VAO);
+    glGenBuffers(1, &lod.VBO);
+    glGenBuffers(1, &lod.EBO);
+    
+    glBindVertexArray(lod.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, lod.VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod.EBO);
+    
+    // Baked at compile time for the standard resolutions; generated otherwise
+    std::vector<PackedMeshVertex> packed;
+    MeshView mesh;
+    if (bakedUVSphere(resolution, mesh)) {
+        packMeshVertices(mesh.vertices, mesh.vertexCount, packed);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexCount * sizeof(uint16_t), mesh.indices, GL_STATIC_DRAW);
+        lod.indexCount = (int)mesh.indexCount;
+        lod.indexType = GL_UNSIGNED_SHORT;
+    } else {
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+        generateUVSphere(resolution, resolution, vertices, indices);
+        size_t vertexCount = vertices.size() / meshVertexFloats;
+        packMeshVertices(vertices.data(), vertexCount, packed);
+        if (vertexCount <= 65536) {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+            lod.indexType = GL_UNSIGNED_SHORT;
+        } else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+            lod.indexType = GL_UNSIGNED_INT;
+        }
+        lod.indexCount = (int)indices.size();
+    }
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedMeshVertex), packed.data(), GL_STATIC_DRAW);
+    
+    // Half-float positions at location 0, packed normals at location 1
+    setupPackedMeshAttributes();
+    
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return lod;
+}
+
+void destroySphereLOD(SphereLOD& lod) {
+    glDeleteVertexArrays(1, &lod.VAO);
+    glDeleteBuffers(1, &lod.VBO);
+    glDeleteBuffers(1, &lod.EBO);
+}
+
+// Pick a LOD for every visible sphere from its projected radius in pixels,
+// write the instances bucketed by LOD into the stream buffer, then queue one
+// instanced draw per non-empty bucket. The stream buffer must be fenced once
+// the queue has been flushed.
+void submitSphereLODs(RenderQueue& queue, GLStateCache& cache, unsigned int program,
+                      const SphereLOD* lods, StreamBuffer& instances, const RenderBodies& bodies,
+                      const std::vector<uint32_t>& visible, std::vector<unsigned char>& instanceLODs,
+                      const glm::mat4& view, const glm::mat4& projection, float viewportHeight) {
+    // Pixels per unit of radius at unit view depth
+    float pixelScale = 0.5f * viewportHeight * projection[1][1];
+    
+    size_t bucketCounts[sphereLODCount] = {};
+    instanceLODs.resize(visible.size());
+    for (size_t k = 0; k < visible.size(); ++k) {
+        uint32_t i = visible[k];
+        float radius = bodies.radius[i];
+        float depth = -(view[0][2] * bodies.x[i] + view[1][2] * bodies.y[i] + view[2][2] * bodies.z[i] + view[3][2]);
+        float pixelRadius = depth > radius ? radius * pixelScale / depth : pixelScale;
         
-        // Add tiny random component only during collision to break symmetry
-        float randomStrength = 0.1f;
-        glm::vec3 randomVec = glm::vec3(
-            (rand() / (float)RAND_MAX - 0.5f) * randomStrength,
-            (rand() / (float)RAND_MAX - 0.5f) * randomStrength,
-            (rand() / (float)RAND_MAX - 0.5f) * randomStrength
-        );
-        sphere.velocity += randomVec;
-        sphere1.velocity -= randomVec; // Conserve momentum
+        int lod = 0;
+        while (lod < sphereLODCount - 1 && pixelRadius < lods[lod].minPixelRadius) lod++;
+        instanceLODs[k] = (unsigned char)lod;
+        bucketCounts[lod]++;
+    }
+    
+    size_t bucketStart[sphereLODCount];
+    size_t cursor[sphereLODCount];
+    size_t total = 0;
+    for (int lod = 0; lod < sphereLODCount; ++lod) {
+        bucketStart[lod] = cursor[lod] = total;
+        total += bucketCounts[lod];
     }
     
-    float maxSpeed = 50.0f;
-    if (glm::length(sphere.velocity) > maxSpeed){
-        sphere.velocity = glm::normalize(sphere.velocity) * maxSpeed;
+    TRACE_ZONE("writeSphereInstances");
+    size_t offset = 0;
+    size_t bytes = total * sizeof(SphereInstance);
+    SphereInstance* mapped = static_cast<SphereInstance*>(beginStreamWrite(instances, bytes, offset));
+    if (!mapped) return;
+    for (size_t k = 0; k < visible.size(); ++k) {
+        writeSphereInstance(mapped[cursor[instanceLODs[k]]++], bodies, visible[k]);
     }
-    if (glm::length(sphere1.velocity) > maxSpeed){
-        sphere1.velocity = glm::normalize(sphere1.velocity) * maxSpeed; // Fixed this line
+    endStreamWrite(instances);
+    recordUpload(cache, bytes);
+    
+    for (int lod = 0; lod < sphereLODCount; ++lod) {
+        if (bucketCounts[lod] == 0) continue;
+        DrawItem item;
+        item.key = makeSortKey(LayerOpaque, program, lods[lod].VAO);
+        item.program = program;
+        item.vertexArray = lods[lod].VAO;
+        item.kind = DrawElementsInstanced;
+        item.primitive = GL_TRIANGLES;
+        item.count = lods[lod].indexCount;
+        item.indexType = lods[lod].indexType;
+        item.instanceCount = (int)bucketCounts[lod];
+        item.bindInstances = setupSphereInstanceAttributes;
+        item.instanceBuffer = instances.buffer;
+        item.instanceBufferVersion = instances.storageVersion;
+        item.instanceOffset = offset + bucketStart[lod] * sizeof(SphereInstance);
+        item.gpuPass = GpuPassSpheres;
+        submitDraw(queue, item);
     }
 }
 
-// Keep your original updatePhysics function - it was working fine
-void updatePhysics(SpherePhysics& sphere, const SpherePhysics& sphere1,const SpherePhysics& sphere2, float deltaTime) {
-    if (!playback) return;
+// Queue every visible sphere as a 4-vertex impostor quad
+void submitSphereImpostors(RenderQueue& queue, GLStateCache& cache, unsigned int program, unsigned int quadVAO,
+                           StreamBuffer& instances, const RenderBodies& bodies, const std::vector<uint32_t>& visible) {
+    size_t offset = 0;
+    if (!writeSphereInstances(instances, bodies, visible, offset)) return;
+    recordUpload(cache, visible.size() * sizeof(SphereInstance));
     
-    const float G = 15.0f;
-    glm::vec3 change1 = sphere1.position - sphere.position;
-    glm::vec3 change2 = sphere2.position - sphere.position;
+    DrawItem item;
+    item.key = makeSortKey(LayerOpaque, program, quadVAO);
+    item.program = program;
+    item.vertexArray = quadVAO;
+    item.kind = DrawArraysInstanced;
+    item.primitive = GL_TRIANGLE_STRIP;
+    item.count = 4;
+    item.instanceCount = (int)visible.size();
+    item.bindInstances = setupSphereInstanceAttributes;
+    item.instanceBuffer = instances.buffer;
+    item.instanceBufferVersion = instances.storageVersion;
+    item.instanceOffset = offset;
+    item.gpuPass = GpuPassSpheres;
+    submitDraw(queue, item);
+}
+
+// Splat vertices read the same per-body data as sphere instances, one
+// vertex per body instead of one instance
+void setupSplatAttributes(unsigned int buffer, size_t offset) {
+    setupSphereInstanceAttributes(buffer, offset);
+    for (unsigned int location = 2; location <= 4; ++location) {
+        glVertexAttribDivisor(location, 0);
+    }
+}
+
+// Floating-point render target the splats accumulate into
+struct SplatTarget {
+    unsigned int framebuffer = 0;
+    unsigned int colorTexture = 0;
+    int width = 0, height = 0;
+};
+
+// (Re)allocate the target's storage when the window size changes
+void resizeSplatTarget(SplatTarget& target, int width, int height) {
+    if (target.framebuffer && target.width == width && target.height == height) return;
     
-    // Calculate distance squared for each sphere
-    float distSq1 = glm::dot(change1, change1);
-    float distSq2 = glm::dot(change2, change2);
+    if (!target.framebuffer) {
+        glGenFramebuffers(1, &target.framebuffer);
+        glGenTextures(1, &target.colorTexture);
+    }
+    target.width = width;
+    target.height = height;
     
-    // Prevent division by zero and extreme forces
-    if (distSq1 > 0.01f && distSq2 > 0.01f) {
-        // Calculate force direction (normalized)
-        glm::vec3 force1Direction = glm::normalize(change1);
-        glm::vec3 force2Direction = glm::normalize(change2);
-        
-        // Calculate force magnitude
-        float forceMag1 = (G * sphere1.mass) / distSq1;
-        float forceMag2 = (G * sphere2.mass) / distSq2;
-        
-        // Apply force as acceleration (F = ma, so a = F/m)
-        sphere.acceleration = (forceMag1 * force1Direction + forceMag2 * force2Direction) / sphere.mass;
+    glBindTexture(GL_TEXTURE_2D, target.colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR: Splat framebuffer incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void destroySplatTarget(SplatTarget& target) {
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteTextures(1, &target.colorTexture);
+    target = SplatTarget();
+}
+
+// Accumulate every visible body into the splat target with additive
+// blending. Depth testing is off: splats are summed, not sorted.
+void drawSplats(RenderQueue& queue, GLStateCache& cache, GpuTimers& timers, unsigned int program, unsigned int splatVAO,
+                SplatTarget& target, StreamBuffer& instances, const RenderBodies& bodies,
+                const std::vector<uint32_t>& visible) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glViewport(0, 0, target.width, target.height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    
+    size_t offset = 0;
+    if (writeSphereInstances(instances, bodies, visible, offset)) {
+        recordUpload(cache, visible.size() * sizeof(SphereInstance));
         
-        // Update velocity based on acceleration
-        sphere.velocity += sphere.acceleration * deltaTime;
+        DrawItem item;
+        item.key = makeSortKey(LayerBlended, program, splatVAO);
+        item.program = program;
+        item.vertexArray = splatVAO;
+        item.primitive = GL_POINTS;
+        item.count = (int)visible.size();
+        item.bindInstances = setupSplatAttributes;
+        item.instanceBuffer = instances.buffer;
+        item.instanceBufferVersion = instances.storageVersion;
+        item.instanceOffset = offset;
+        item.gpuPass = GpuPassSpheres;
+        submitDraw(queue, item);
         
-        // Update position based on velocity
-        sphere.position += sphere.velocity * deltaTime;
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        flushRenderQueue(queue, cache, &timers);
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
     }
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
 }
 
-// Function to generate sphere vertices and normals
-void generateSphereVertices(int latRes, int lonRes, float radius, float*& vertices, unsigned int*& indices, int& vertexCount, int& indexCount) {
-    const float PI = 3.14159265359f;
+// Tonemap the accumulated splats and add them over the scene
+void drawSplatTonemap(RenderQueue& queue, GLStateCache& cache, unsigned int program, unsigned int emptyVAO,
+                      const SplatTarget& target) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, target.colorTexture);
     
-    vertexCount = (latRes + 1) * (lonRes + 1);
-    indexCount = latRes * lonRes * 6;
+    DrawItem item;
+    item.key = makeSortKey(LayerOverlay, program, emptyVAO);
+    item.program = program;
+    item.vertexArray = emptyVAO;
+    item.primitive = GL_TRIANGLES;
+    item.count = 3;
+    submitDraw(queue, item);
     
-    vertices = new float[vertexCount * 6]; // 3 for position, 3 for normal
-    indices = new unsigned int[indexCount];
-    
-    int vertexIndex = 0;
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    flushRenderQueue(queue, cache);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Sheet heights: potential * G * scale, clamped so wells stay on screen
+// (applied by the sheet's vertex shader)
+const int sheetResolution = 512;
+const int sheetLineStride = 8;      // Draw every 8th row and column of samples
+const float sheetDepthScale = 0.15f;
+const float sheetMaxDepth = 20.0f;
+
+// The sampled sheet drawn as lines along its rows and columns. Sampling is
+// much finer than the line spacing, so the lines bend smoothly into wells.
+// The potential comes from a PotentialWorker; until its first sheet
+// arrives the sheet is flat.
+struct GravitySheet {
+    unsigned int VAO, positionVBO, potentialVBO, EBO;
+    int indexCount;
+    PotentialSheet params;
+    bool stale = true;      // The worker has not been given the current bodies
+};
+
+GravitySheet createGravitySheet(float extent) {
+    GravitySheet sheet;
+    int res = sheetResolution;
+    sheet.params.resolution = res;
+    sheet.params.origin = -0.5f * extent;
+    sheet.params.spacing = extent / (res - 1);
     
-    // Generate vertices
-    for (int lat = 0; lat <= latRes; lat++) {
-        float theta = PI * ((float)lat / (float)latRes);
-        float sinTheta = sin(theta);
-        float cosTheta = cos(theta);
-        
-        for (int lon = 0; lon <= lonRes; lon++) {
-            float phi = 2.0f * PI * ((float)lon / (float)lonRes);
-            float sinPhi = sin(phi);
-            float cosPhi = cos(phi);
-            
-            float x = cosPhi * sinTheta;
-            float y = cosTheta;
-            float z = sinPhi * sinTheta;
-            
-            // Position
-            vertices[vertexIndex * 6] = radius * x;
-            vertices[vertexIndex * 6 + 1] = radius * y;
-            vertices[vertexIndex * 6 + 2] = radius * z;
-            
-            // Normal (same as position for unit sphere)
-            vertices[vertexIndex * 6 + 3] = x;
-            vertices[vertexIndex * 6 + 4] = y;
-            vertices[vertexIndex * 6 + 5] = z;
-            
-            vertexIndex++;
+    std::vector<float> positions;
+    positions.reserve((size_t)res * res * 2);
+    for (int row = 0; row < res; ++row) {
+        for (int col = 0; col < res; ++col) {
+            positions.push_back(sheet.params.origin + col * sheet.params.spacing);
+            positions.push_back(sheet.params.origin + row * sheet.params.spacing);
         }
     }
     
-    // Generate indices
-    int indexIdx = 0;
-    for (int lat = 0; lat < latRes; lat++) {
-        for (int lon = 0; lon < lonRes; lon++) {
-            int first = lat * (lonRes + 1) + lon;
-            int second = first + lonRes + 1;
-            
-            // First triangle
-            indices[indexIdx++] = first;
-            indices[indexIdx++] = second;
-            indices[indexIdx++] = first + 1;
-            
-            // Second triangle
-            indices[indexIdx++] = second;
-            indices[indexIdx++] = second + 1;
-            indices[indexIdx++] = first + 1;
+    std::vector<unsigned int> indices;
+    for (int line = 0; line < res; ++line) {
+        if (line % sheetLineStride != 0 && line != res - 1) continue;
+        for (int k = 0; k + 1 < res; ++k) {
+            // Along the row, then along the column
+            indices.push_back(line * res + k);
+            indices.push_back(line * res + k + 1);
+            indices.push_back(k * res + line);
+            indices.push_back((k + 1) * res + line);
         }
     }
+    sheet.indexCount = (int)indices.size();
+    
+    glGenVertexArrays(1, &sheet.VAO);
+    glGenBuffers(1, &sheet.positionVBO);
+    glGenBuffers(1, &sheet.potentialVBO);
+    glGenBuffers(1, &sheet.EBO);
+    glBindVertexArray(sheet.VAO);
+    
+    glBindBuffer(GL_ARRAY_BUFFER, sheet.positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    
+    std::vector<float> flat((size_t)res * res, 0.0f);
+    glBindBuffer(GL_ARRAY_BUFFER, sheet.potentialVBO);
+    glBufferData(GL_ARRAY_BUFFER, flat.size() * sizeof(float), flat.data(), GL_STREAM_DRAW);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sheet.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return sheet;
 }
 
-std::vector<float> generateGridVertices(int size, float spacing) {
-    std::vector<float> gridVertices;
-    float halfSize = (size - 1) * spacing * 0.5f;
-    
-    // Generate horizontal lines (XZ plane)
-    for (int i = 0; i < size; ++i) {
-        float z = -halfSize + i * spacing;
-        // Line along X axis
-        gridVertices.insert(gridVertices.end(), {-halfSize, 0.0f, z});
-        gridVertices.insert(gridVertices.end(), {halfSize, 0.0f, z});
+void destroyGravitySheet(GravitySheet& sheet) {
+    glDeleteVertexArrays(1, &sheet.VAO);
+    glDeleteBuffers(1, &sheet.positionVBO);
+    glDeleteBuffers(1, &sheet.potentialVBO);
+    glDeleteBuffers(1, &sheet.EBO);
+}
+
+// Hand the worker the current bodies if it has not seen them, and stream
+// the newest finished potential if one arrived. Returns the bytes uploaded.
+size_t updateGravitySheet(GravitySheet& sheet, PotentialWorker& worker, const RenderBodies& bodies) {
+    TRACE_ZONE("updateGravitySheet");
+    if (sheet.stale) {
+        requestPotentialSheet(worker, bodies);
+        sheet.stale = false;
     }
+    if (!consumeSnapshot(worker.sheets)) return 0;
     
-    // Generate vertical lines (XZ plane)
-    for (int i = 0; i < size; ++i) {
-        float x = -halfSize + i * spacing;
-        // Line along Z axis
-        gridVertices.insert(gridVertices.end(), {x, 0.0f, -halfSize});
-        gridVertices.insert(gridVertices.end(), {x, 0.0f, halfSize});
-    }
-    return gridVertices;
+    // Orphan the last sheet instead of waiting for the GPU to finish with it
+    const std::vector<float>& potential = snapshotReadSlot(worker.sheets);
+    size_t bytes = potential.size() * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, sheet.potentialVBO);
+    glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, potential.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return bytes;
 }
 
-
-// Function to check shader compilation errors
-void checkShaderCompilation(unsigned int shader, const char* type) {
-    int success;
-    char infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cerr << "ERROR: " << type << " shader compilation failed\n" << infoLog << std::endl;
+// Lay out the performance overlay: rolling average and p99 of every phase,
+// then the driver work per frame
+// One overlay row of a kernel's counters: IPC, L1 misses per interaction,
+// LLC misses per body and branch misses per interaction ("-" if unavailable)
+std::string counterLine(const char* kernel, const PerfCounterSample& sample, size_t bodyCount, double interactions) {
+    double cycles = hasPerfCounter(sample, CounterCycles) ? (double)sample.values[CounterCycles] : 0.0;
+    const double values[4] = {
+        perfCounterRatio(sample, CounterInstructions, cycles),
+        perfCounterRatio(sample, CounterL1Misses, interactions),
+        perfCounterRatio(sample, CounterLLCMisses, (double)bodyCount),
+        perfCounterRatio(sample, CounterBranchMisses, interactions)};
+    
+    char line[96];
+    int length = std::snprintf(line, sizeof(line), "%-9s", kernel);
+    for (double value : values) {
+        if (value < 0.0) {
+            length += std::snprintf(line + length, sizeof(line) - length, " %7s", "-");
+        } else {
+            length += std::snprintf(line + length, sizeof(line) - length, " %7.3f", value);
+        }
     }
+    return line;
 }
 
-// Function to check shader program linking errors
-void checkProgramLinking(unsigned int program) {
-    int success;
-    char infoLog[512];
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(program, 512, NULL, infoLog);
-        std::cerr << "ERROR: Shader program linking failed\n" << infoLog << std::endl;
+// `step` carries the latest step's hardware counters, or is null when they are off
+void buildPerfText(TextOverlay& text, const Profiler& profiler, const RenderStats& perFrame, const StepTimings* step) {
+    const float scale = 2.0f;
+    const float lineHeight = textCellHeight * scale;
+    const float margin = 8.0f;
+    const int lineCount = PhaseCount + 3 + (step ? 3 : 0);
+    const int columns = step ? 41 : 34;
+    
+    clearText(text);
+    addTextPanel(text, 0.0f, 0.0f, 2 * margin + columns * textCellWidth * scale, 2 * margin + lineCount * lineHeight,
+                 glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+    
+    char line[96];
+    float y = margin;
+    addText(text, margin, y, scale, "phase            avg ms   p99 ms", glm::vec4(0.6f, 0.8f, 1.0f, 1.0f));
+    y += lineHeight;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        const PhaseTimes& times = profiler.phases[phase];
+        std::snprintf(line, sizeof(line), "%-15s %8.2f %8.2f", profilePhaseNames[phase],
+                      phaseAverage(times), phasePercentile(times, 0.99f));
+        addText(text, margin, y, scale, line, glm::vec4(1.0f));
+        y += lineHeight;
     }
+    std::snprintf(line, sizeof(line), "draws %u, state changes %u", perFrame.drawCalls, perFrame.stateChanges());
+    addText(text, margin, y, scale, line, glm::vec4(0.6f, 0.8f, 1.0f, 1.0f));
+    y += lineHeight;
+    std::snprintf(line, sizeof(line), "uploads %.1f kb/frame", perFrame.bytesUploaded / 1024.0);
+    addText(text, margin, y, scale, line, glm::vec4(0.6f, 0.8f, 1.0f, 1.0f));
+    if (!step) return;
+    
+    y += lineHeight;
+    addText(text, margin, y, scale, "counters      ipc  l1/int llc/bod  br/int", glm::vec4(0.6f, 0.8f, 1.0f, 1.0f));
+    y += lineHeight;
+    addText(text, margin, y, scale, counterLine("gravity", step->gravityCounters, step->bodyCount,
+                                                gravityInteractions(step->bodyCount)), glm::vec4(1.0f));
+    y += lineHeight;
+    addText(text, margin, y, scale, counterLine("collision", step->collisionCounters, step->bodyCount,
+                                                collisionInteractions(step->bodyCount)), glm::vec4(1.0f));
 }
 
-// Function to draw a sphere with given properties
-void drawSphere(unsigned int shaderProgram, unsigned int VAO, int indexCount, 
-                const SpherePhysics& sphere, float currentTime,
-                const glm::mat4& view, const glm::mat4& projection,
-                const glm::vec3& lightPos, const glm::vec3& cameraPos, 
-                const glm::vec3& lightColor,
-                int modelLoc, int viewLoc, int projectionLoc, 
-                int lightPosLoc, int viewPosLoc, int lightColorLoc, int objectColorLoc) {
-    
-    // Model matrix (translate to sphere's current position)
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, sphere.position);
-    // Optional: add rotation for visual effect
-    model = glm::rotate(model, currentTime * 0.5f, glm::vec3(0.5f, 1.0f, 0.0f));
-    
-    // Set uniforms
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glUniform3fv(lightPosLoc, 1, glm::value_ptr(lightPos));
-    glUniform3fv(viewPosLoc, 1, glm::value_ptr(cameraPos));
-    glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
-    glUniform3fv(objectColorLoc, 1, glm::value_ptr(sphere.color));
-    
-    // Draw sphere
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+// Sampler units for the light clusters, shared by the sphere and impostor programs
+void setupClusterSamplers(ShaderProgram& program) {
+    glUniform1i(uniformLocation(program, "clusterGrid"), clusterGridUnit);
+    glUniform1i(uniformLocation(program, "clusterLightIndices"), clusterIndexUnit);
+    glUniform1i(uniformLocation(program, "clusterLights"), clusterLightUnit);
 }
 
-int main() {
+// Usage: main [--load <file> | --scene <name> [--count <n>] [--seed <s>] [--stars <n>]]
+//             [--record <file>] [--replay <file>] [--shader-dir <dir>] [--trace <file>]
+//             [--counters <file>]
+//   --load    initial conditions from a CSV or binary body list
+//   --scene   generated initial conditions: plummer, king, disk, sphere,
+//             granular or lattice (default 1000 bodies, seed 1)
+//   --stars   turn n of the generated bodies into stars that light their neighbours
+//   --record  write every simulated step to a trajectory file
+//   --replay  play a recorded trajectory instead of simulating
+//   --shader-dir  read shaders from <dir>/<name>.vert/.frag (created from the
+//             built-in sources if missing) and reload them when they change
+//   --trace   where F12 and exit write the traced zones (default trace.json;
+//             needs a tracing build, make TRACE=1)
+//   --counters  read hardware counters around the gravity and collision
+//             kernels (Linux perf_event_open), write one CSV row per step to
+//             <file> and show the newest step's in the P overlay
+int main(int argc, char** argv) {
+    const char* loadPath = nullptr;
+    const char* sceneName = nullptr;
+    SceneParams scene;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* shaderDir = nullptr;
+    const char* tracePath = nullptr;
+    const char* countersPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            loadPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            sceneName = argv[++i];
+            if (!parseSceneType(sceneName, scene.type)) {
+                std::cerr << "Unknown scene: " << sceneName << std::endl;
+                return -1;
+            }
+        } else if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            scene.count = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            scene.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--stars") == 0 && i + 1 < argc) {
+            scene.starCount = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+            shaderDir = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--counters") == 0 && i + 1 < argc) {
+            countersPath = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            return -1;
+        }
+    }
+    if (tracePath && !tracingEnabled) {
+        std::cerr << "WARNING: --trace ignored, tracing is not compiled in (build with make TRACE=1)" << std::endl;
+    }
+    TRACE_THREAD_NAME("render");
+    
+    if (loadPath && !replayPath) {
+        if (!loadBodies(loadPath, spheres)) return -1;
+        std::cout << "Loaded " << spheres.size() << " bodies from " << loadPath << std::endl;
+    } else if (sceneName && !replayPath) {
+        generateScene(scene, spheres);
+        std::cout << "Generated " << spheres.size() << " bodies (" << sceneName << ")" << std::endl;
+    }
+    
+    // A replay drives the spheres from the recorded frames instead of physics
+    TrajectoryReader replay;
+    if (replayPath) {
+        if (!openTrajectoryReader(replay, replayPath)) return -1;
+        
+        spheres.assign(replay.header->bodyCount, SpherePhysics{});
+        for (uint32_t i = 0; i < replay.header->bodyCount; ++i) {
+            const TrajectoryBody& body = replay.bodies[i];
+            spheres[i].radius = body.radius;
+            spheres[i].mass = 1.0f; // Not recorded; only the gravity sheet uses it
+            spheres[i].color = glm::vec3(body.color[0], body.color[1], body.color[2]);
+        }
+    }
+    
+    TrajectoryWriter recorder;
+    if (recordPath && !replayPath) {
+        if (!openTrajectoryWriter(recorder, recordPath, spheres)) return -1;
+        appendTrajectoryFrame(recorder, spheres, 0.0);
+    }
+    
+    // Counters need steps to count; a replay has none
+    FILE* countersFile = nullptr;
+    if (countersPath && replayPath) {
+        std::cerr << "WARNING: --counters ignored while replaying" << std::endl;
+    } else if (countersPath) {
+        countersFile = std::fopen(countersPath, "w");
+        if (!countersFile) {
+            std::cerr << "ERROR: Could not write " << countersPath << std::endl;
+            return -1;
+        }
+    }
+    
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -392,6 +1025,16 @@ int main() {
             
             switch (key) {
                 case GLFW_KEY_SPACE: playback = !playback; break;
+                case GLFW_KEY_LEFT: replaySeekRequest -= 5.0; break;
+                case GLFW_KEY_RIGHT: replaySeekRequest += 5.0; break;
+                case GLFW_KEY_HOME: replayRestartRequest = true; break;
+                case GLFW_KEY_M:
+                    renderMode = (RenderMode)((renderMode + 1) % RenderModeCount);
+                    break;
+                case GLFW_KEY_T: showTrails = !showTrails; break;
+                case GLFW_KEY_G: showGravitySheet = !showGravitySheet; break;
+                case GLFW_KEY_P: showPerfOverlay = !showPerfOverlay; break;
+                case GLFW_KEY_F12: traceWriteRequest = true; break;
                 case GLFW_KEY_ESCAPE:
                     glfwSetWindowShouldClose(window, true);
                     break;
@@ -411,71 +1054,41 @@ int main() {
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
     
-    // Generate sphere vertices
-    int latRes = 30;
-    int lonRes = 30;
-    float radius = 1.0f;
-    float* vertices;
-    unsigned int* indices;
-    int vertexCount, indexCount;
-    
-    generateSphereVertices(latRes, lonRes, radius, vertices, indices, vertexCount, indexCount);
-    
-    // Create and bind a Vertex Array Object (VAO)
-    unsigned int VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    
-    glBindVertexArray(VAO);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertexCount * 6 * sizeof(float), vertices, GL_STATIC_DRAW);
+    // Sphere level-of-detail chain, finest first
+    SphereLOD sphereLODs[sphereLODCount];
+    for (int lod = 0; lod < sphereLODCount; ++lod) {
+        sphereLODs[lod] = createSphereLOD(sphereLODResolutions[lod], sphereLODMinPixelRadius[lod]);
+    }
+    std::vector<unsigned char> instanceLODs;
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    // Per-frame render state: bodies in SoA form and the indices that survive
+    // culling. Replays fill renderBodies here; simulations draw the newest
+    // snapshot from the simulation thread.
+    RenderBodies renderBodies;
+    std::vector<uint32_t> visibleBodies;
     
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // Per-instance attributes, rewritten every frame by submitSphereLODs
+    StreamBuffer sphereInstances;
+    createStreamBuffer(sphereInstances, GL_ARRAY_BUFFER, spheres.size() * sizeof(SphereInstance));
     
-    // Normal attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // Every program is registered here and built together below, from the
+    // binary cache when the sources and driver have not changed
+    ProgramManager programs;
+    initProgramManager(programs, "shader_cache", shaderDir);
+    unsigned int frameDataPrelude = addShaderPrelude(programs, frameDataBlockSource, true, true);
+    unsigned int lightingPrelude = addShaderPrelude(programs, clusterLightingShaderSource(), false, true);
     
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    ShaderProgram sphereProgram;
+    // Locations of uniforms set every frame, resolved whenever their program is (re)built
+    int sphereSpinLocation = -1;
+    addProgram(programs, sphereProgram, "sphere", vertexShaderSource, fragmentShaderSource, frameDataPrelude | lightingPrelude, [&](ShaderProgram& program) {
+        setupClusterSamplers(program);
+        sphereSpinLocation = uniformLocation(program, "spin");
+    });
     
-    // Clean up vertex data
-    delete[] vertices;
-    delete[] indices;
-    
-    // Compile vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    checkShaderCompilation(vertexShader, "VERTEX");
-    
-    // Compile fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    checkShaderCompilation(fragmentShader, "FRAGMENT");
-    
-    // Link shaders into a shader program
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    checkProgramLinking(shaderProgram);
-    
-    // Clean up shaders
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    
-	int gridSize = 25;
-	float spacing = 5.0f;
-	std::vector<float> gridVertices = generateGridVertices(gridSize, spacing);
+	constexpr int gridSize = 25;
+	constexpr float spacing = 5.0f;
+	static constexpr auto gridVertices = makeGridLines<gridSize>(spacing);
 
 	unsigned int gridVAO, gridVBO;
 	glGenVertexArrays(1, &gridVAO);
@@ -492,42 +1105,112 @@ int main() {
 	glBindVertexArray(0);
 	
 	
-	unsigned int lineVertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(lineVertexShader, 1, &lineVertexShaderSource, NULL);
-	glCompileShader(lineVertexShader);
-	checkShaderCompilation(lineVertexShader, "LINE_VERTEX");
-
-	unsigned int lineFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(lineFragmentShader, 1, &lineFragmentShaderSource, NULL);
-	glCompileShader(lineFragmentShader);
-	checkShaderCompilation(lineFragmentShader, "LINE_FRAGMENT");
-
-	unsigned int lineShaderProgram = glCreateProgram();
-	glAttachShader(lineShaderProgram, lineVertexShader);
-	glAttachShader(lineShaderProgram, lineFragmentShader);
-	glLinkProgram(lineShaderProgram);
-	checkProgramLinking(lineShaderProgram);
-
-	glDeleteShader(lineVertexShader);
-	glDeleteShader(lineFragmentShader);
+	// The grid's model matrix and color never change
+	ShaderProgram lineProgram;
+	addProgram(programs, lineProgram, "line", lineVertexShaderSource, lineFragmentShaderSource, frameDataPrelude, [](ShaderProgram& program) {
+		glm::mat4 gridModel = glm::mat4(1.0f);
+		glUniformMatrix4fv(uniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(gridModel));
+		glUniform3f(uniformLocation(program, "lineColor"), 0.3f, 0.3f, 0.3f); // Dim gray
+	});
+	
+    // Impostor quad: four corners drawn as a triangle strip, plus the same
+    // per-instance attributes as the sphere mesh
+    float quadCorners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+    unsigned int impostorVAO, impostorVBO;
+    glGenVertexArrays(1, &impostorVAO);
+    glGenBuffers(1, &impostorVBO);
+    
+    glBindVertexArray(impostorVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, impostorVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadCorners), quadCorners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    
+    ShaderProgram impostorProgram;
+    addProgram(programs, impostorProgram, "impostor", impostorVertexShaderSource, impostorFragmentShaderSource, frameDataPrelude | lightingPrelude, setupClusterSamplers);
+    
+    // Emitting bodies light the spheres through per-frame light clusters
+    LightClusters lightClusters;
+    createLightClusters(lightClusters);
+    
+    // Splat mode: a VAO for the per-body points, the accumulation target and
+    // an attribute-less VAO for the fullscreen tonemap triangle
+    ShaderProgram splatProgram;
+    int splatPointScaleLocation = -1;
+    addProgram(programs, splatProgram, "splat", splatVertexShaderSource, splatFragmentShaderSource, frameDataPrelude, [&](ShaderProgram& program) {
+        glUniform1f(uniformLocation(program, "splatIntensity"), 4.0f);
+        splatPointScaleLocation = uniformLocation(program, "pointScale");
+    });
+    ShaderProgram tonemapProgram;
+    addProgram(programs, tonemapProgram, "tonemap", tonemapVertexShaderSource, tonemapFragmentShaderSource, 0, [](ShaderProgram& program) {
+        glUniform1i(uniformLocation(program, "density"), 0);
+        glUniform1f(uniformLocation(program, "exposure"), 1.0f);
+    });
+    unsigned int splatVAO, emptyVAO;
+    glGenVertexArrays(1, &splatVAO);
+    glGenVertexArrays(1, &emptyVAO);
+    SplatTarget splatTarget;
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    
+    // Trail history is allocated the first time trails are shown
+    ShaderProgram trailProgram;
+    int trailHeadLocation = -1, trailLengthLocation = -1, trailBodyCountLocation = -1;
+    addProgram(programs, trailProgram, "trail", trailVertexShaderSource, trailFragmentShaderSource, frameDataPrelude, [&](ShaderProgram& program) {
+        glUniform1i(uniformLocation(program, "trailPositions"), 1);
+        glUniform1i(uniformLocation(program, "trailColors"), 2);
+        trailHeadLocation = uniformLocation(program, "trailHead");
+        trailLengthLocation = uniformLocation(program, "trailLength");
+        trailBodyCountLocation = uniformLocation(program, "trailBodyCount");
+    });
+    TrailBuffer trails;
+    
+    // Gravity sheet over the same area as the grid
+    ShaderProgram sheetProgram;
+    addProgram(programs, sheetProgram, "sheet", sheetVertexShaderSource, sheetFragmentShaderSource, frameDataPrelude, [](ShaderProgram& program) {
+        glUniform1f(uniformLocation(program, "depthScale"), gravitationalConstant * sheetDepthScale);
+        glUniform1f(uniformLocation(program, "maxDepth"), sheetMaxDepth);
+    });
+    GravitySheet gravitySheet = createGravitySheet((gridSize - 1) * spacing);
+    PotentialWorker sheetWorker;
+    startPotentialWorker(sheetWorker, gravitySheet.params);
+    
+    // Performance overlay text
+    ShaderProgram textProgram;
+    int textViewportSizeLocation = -1;
+    addProgram(programs, textProgram, "text", textVertexShaderSource, textFragmentShaderSource, 0, [&](ShaderProgram& program) {
+        glUniform1i(uniformLocation(program, "font"), 0);
+        textViewportSizeLocation = uniformLocation(program, "viewportSize");
+    });
+    TextOverlay perfText;
+    createTextOverlay(perfText);
+    
+    double buildStart = glfwGetTime();
+    buildPrograms(programs);
+    std::cout << "Built " << programs.programs.size() << " shader programs in "
+              << (int)((glfwGetTime() - buildStart) * 1000.0) << " ms"
+              << (programs.binaryCache ? " (binary cache on" : " (binary cache off")
+              << (programs.parallelCompile ? ", parallel compile)" : ")") << std::endl;
+    
+    // View, projection, camera and light live in one uniform buffer shared
+    // by every program, uploaded once per frame
+    unsigned int frameUBO;
+    glGenBuffers(1, &frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, frameDataBinding, frameUBO);
 
 	
     // Set clear color
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     
-    // Get uniform locations
-    int modelLoc = glGetUniformLocation(shaderProgram, "model");
-    int viewLoc = glGetUniformLocation(shaderProgram, "view");
-    int projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-    int lightPosLoc = glGetUniformLocation(shaderProgram, "lightPos");
-    int viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
-    int lightColorLoc = glGetUniformLocation(shaderProgram, "lightColor");
-    int objectColorLoc = glGetUniformLocation(shaderProgram, "objectColor");
-    
     // Camera settings
     glm::vec3 cameraPos = glm::vec3(30.0f, 15.0f, 30.0f);
     glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, 0.0f);
     glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
+    const float nearPlane = 0.1f;
+    const float farPlane = 200.0f;
     
     // Lighting settings
     glm::vec3 lightPos = glm::vec3(5.0f, 5.0f, 5.0f);
@@ -535,25 +1218,103 @@ int main() {
     
     // Timing variables
     float lastTime = glfwGetTime();
+    double replayTime = 0.0;
+    uint64_t replayFrame = UINT64_MAX;     // Frame the bodies were last set from
+    
+    // Every draw goes through the queue; binds it would repeat are skipped
+    RenderQueue renderQueue;
+    GLStateCache stateCache;
+    invalidateStateCache(stateCache);
     
-    // Use shader program
-    glUseProgram(shaderProgram);
+    // Driver work summed over the last second, shown in the window title
+    RenderStats statsTotal;
+    int statsFrames = 0;
+    double statsStart = glfwGetTime();
+    RenderStats statsPerFrame;      // Last second's totals divided by its frame count
+    StepTimings lastStep;           // Counters of the newest step, for the overlay
+    
+    // Phase timings for the overlay; GPU passes are timed through the queue
+    Profiler profiler;
+    GpuTimers gpuTimers;
+    createGpuTimers(gpuTimers);
+    auto previousFrameStart = std::chrono::steady_clock::now();
+    double perfTextRefresh = 0.0;
+    
+    FrameData frameData;
+    frameData.cameraPos = glm::vec4(cameraPos, 1.0f);
+    frameData.lightPos = glm::vec4(lightPos, 1.0f);
+    frameData.lightColor = glm::vec4(lightColor, 1.0f);
+    
+    // Physics steps on its own thread from here on; the render loop only
+    // reads the snapshots it publishes
+    SimThread sim;
+    sim.countersFile = countersFile;
+    if (!replayPath) startSimThread(sim, spheres, recorder.file ? &recorder : nullptr);
+    uint64_t statsStepCount = 0;
     
     // Render loop
     while (!glfwWindowShouldClose(window)) {	
+        TRACE_ZONE("frame");
+        
         // Calculate delta time
         float currentTime = glfwGetTime();
         float deltaTime = currentTime - lastTime;
         lastTime = currentTime;
         
-        // Update physics for all spheres
-        updatePhysics(sphere, sphere2, sphere3, deltaTime);
-        updatePhysics(sphere2, sphere, sphere3, deltaTime);
-        updatePhysics(sphere3, sphere, sphere2, deltaTime);
+        auto frameStart = std::chrono::steady_clock::now();
+        recordPhase(profiler, PhaseFrame, std::chrono::duration<double, std::milli>(frameStart - previousFrameStart).count());
+        previousFrameStart = frameStart;
+        beginGpuFrame(gpuTimers, profiler);
+        
+        // Edited shaders were rebuilt (and replaced their programs if they linked); cached binds and uniform values are stale
+        if (reloadChangedPrograms(programs, currentTime)) invalidateStateCache(stateCache);
         
-		handleCollisions(sphere, sphere2);	
-		handleCollisions(sphere, sphere3);
-		handleCollisions(sphere2, sphere3);
+        const RenderBodies* frameBodies = &renderBodies;
+        if (replayPath) {
+            ScopedPhaseTimer timer(profiler, PhaseSync);
+            TRACE_ZONE("sync");
+            // Advance through the recording; the space bar pauses it like the simulation
+            if (playback) replayTime += deltaTime;
+            
+            // Trails would draw a line across any jump in time
+            if (replaySeekRequest != 0.0 || replayRestartRequest || replayTime > replay.header->duration) {
+                resetTrails(trails);
+            }
+            replayTime += replaySeekRequest;
+            replaySeekRequest = 0.0;
+            if (replayRestartRequest || replayTime < 0.0) replayTime = 0.0;
+            replayRestartRequest = false;
+            if (replayTime > replay.header->duration) replayTime = 0.0; // Loop
+            
+            uint64_t frame = findTrajectoryFrame(replay, replayTime);
+            if (frame != replayFrame) gravitySheet.stale = true;
+            replayFrame = frame;
+            const float* positions = trajectoryFramePositions(replay, frame);
+            for (SpherePhysics& body : spheres) {
+                body.position = glm::vec3(positions[0], positions[1], positions[2]);
+                positions += 3;
+            }
+            gatherRenderBodies(spheres, renderBodies);
+        } else {
+            // Whatever the simulation published last; keep the previous
+            // snapshot if no step finished since the last frame
+            ScopedPhaseTimer timer(profiler, PhaseSync);
+            TRACE_ZONE("sync");
+            bool fresh = consumeSnapshot(sim.snapshots);
+            const SimSnapshot& snapshot = snapshotReadSlot(sim.snapshots);
+            frameBodies = &snapshot.bodies;
+            if (fresh) gravitySheet.stale = true;
+            
+            // One sample per step finished since the last frame, including
+            // those whose snapshots were overwritten before this frame
+            StepTimings step;
+            while (popRing(sim.stepTimings, step)) {
+                recordPhase(profiler, PhaseSimGravity, step.gravity);
+                recordPhase(profiler, PhaseSimIntegrate, step.integrate);
+                recordPhase(profiler, PhaseSimCollisions, step.collisions);
+                lastStep = step;
+            }
+        }
 		
         // Clear the screen and depth buffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -565,47 +1326,215 @@ int main() {
         glm::mat4 view = glm::lookAt(cameraPos, cameraTarget, cameraUp);
         
         // Projection matrix (perspective)
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 200.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspectRatio, nearPlane, farPlane);
+        
+        // Bin this frame's emitters; the spheres read the result while shading
+        if (renderMode != RenderSplat) {
+            ScopedPhaseTimer timer(profiler, PhaseLights);
+            recordUpload(stateCache, updateLightClusters(lightClusters, *frameBodies, view, projection,
+                                                         windowWidth, windowHeight, farPlane));
+            bindLightClusters(lightClusters);
+        }
         
-        // Draw first sphere
-        drawSphere(shaderProgram, VAO, indexCount, sphere, currentTime, 
-                  view, projection, lightPos, cameraPos, lightColor,
-                  modelLoc, viewLoc, projectionLoc, lightPosLoc, viewPosLoc, lightColorLoc, objectColorLoc);
+        frameData.view = view;
+        frameData.projection = projection;
+        frameData.clusterParams = lightClusters.shaderParams;
+        {
+            TRACE_ZONE("uploadFrameData");
+            glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &frameData);
+            recordUpload(stateCache, sizeof(FrameData));
+        }
         
-        // Draw second sphere
-        drawSphere(shaderProgram, VAO, indexCount, sphere2, currentTime, 
-                  view, projection, lightPos, cameraPos, lightColor,
-                  modelLoc, viewLoc, projectionLoc, lightPosLoc, viewPosLoc, lightColorLoc, objectColorLoc);
+        // Only bodies whose bounding spheres touch the view frustum are submitted
+        {
+            ScopedPhaseTimer timer(profiler, PhaseCull);
+            TRACE_ZONE("cull");
+            FrustumPlanes frustum;
+            extractFrustumPlanes(projection * view, frustum);
+            cullSpheres(frustum, *frameBodies, visibleBodies);
+        }
         
-        // Draw third sphere
-        drawSphere(shaderProgram, VAO, indexCount, sphere3, currentTime, 
-                  view, projection, lightPos, cameraPos, lightColor,
-                  modelLoc, viewLoc, projectionLoc, lightPosLoc, viewPosLoc, lightColorLoc, objectColorLoc);
+        // Instance writes and draw submission (splats are also drawn here)
+        auto submitStart = std::chrono::steady_clock::now();
         
-		glUseProgram(lineShaderProgram);
-		glm::mat4 gridModel = glm::mat4(1.0f);
-		glUniformMatrix4fv(glGetUniformLocation(lineShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(gridModel));
-		glUniformMatrix4fv(glGetUniformLocation(lineShaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(glGetUniformLocation(lineShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-		glUniform3f(glGetUniformLocation(lineShaderProgram, "lineColor"), 0.3f, 0.3f, 0.3f); // Dim gray
-
-		glBindVertexArray(gridVAO);
-		glDrawArrays(GL_LINES, 0, gridVertices.size() / 3);
+        if (renderMode == RenderSplat) {
+            resizeSplatTarget(splatTarget, windowWidth, windowHeight);
+            useProgram(stateCache, splatProgram.id);
+            setUniformFloat(stateCache, splatProgram.id, splatPointScaleLocation, 0.5f * windowHeight * projection[1][1]);
+            drawSplats(renderQueue, stateCache, gpuTimers, splatProgram.id, splatVAO, splatTarget,
+                       sphereInstances, *frameBodies, visibleBodies);
+        } else if (renderMode == RenderImpostor) {
+            submitSphereImpostors(renderQueue, stateCache, impostorProgram.id, impostorVAO,
+                                  sphereInstances, *frameBodies, visibleBodies);
+        } else {
+            // Optional: add rotation for visual effect (also the normal matrix)
+            glm::mat3 spin = glm::mat3(glm::rotate(glm::mat4(1.0f), currentTime * 0.5f, glm::vec3(0.5f, 1.0f, 0.0f)));
+            setUniformMatrix3(stateCache, sphereProgram.id, sphereSpinLocation, spin);
+            
+            // Every sphere, one instanced draw per level of detail
+            submitSphereLODs(renderQueue, stateCache, sphereProgram.id, sphereLODs, sphereInstances,
+                             *frameBodies, visibleBodies, instanceLODs, view, projection, (float)windowHeight);
+        }
+        
+        if (showTrails) {
+            if (trails.bodyCount != frameBodies->size()) {
+                if (trails.positionBuffer) destroyTrailBuffer(trails);
+                createTrailBuffer(trails, *frameBodies);
+            }
+            recordUpload(stateCache, appendTrailSample(trails, *frameBodies, currentTime));
+            
+            if (trails.filled >= 2) {
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_BUFFER, trails.positionTexture);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_BUFFER, trails.colorTexture);
+                glActiveTexture(GL_TEXTURE0);
+                
+                useProgram(stateCache, trailProgram.id);
+                setUniformInt(stateCache, trailProgram.id, trailHeadLocation, trails.head);
+                setUniformInt(stateCache, trailProgram.id, trailLengthLocation, trails.length);
+                setUniformInt(stateCache, trailProgram.id, trailBodyCountLocation, (int)trails.bodyCount);
+                
+                DrawItem trail;
+                trail.key = makeSortKey(LayerOpaque, trailProgram.id, emptyVAO);
+                trail.program = trailProgram.id;
+                trail.vertexArray = emptyVAO;
+                trail.kind = DrawArraysInstanced;
+                trail.primitive = GL_LINE_STRIP;
+                trail.count = trails.filled;
+                trail.instanceCount = (int)trails.bodyCount;
+                trail.gpuPass = GpuPassTrails;
+                submitDraw(renderQueue, trail);
+            }
+        }
+        
+        if (showGravitySheet) {
+            recordUpload(stateCache, updateGravitySheet(gravitySheet, sheetWorker, *frameBodies));
+            
+            DrawItem sheet;
+            sheet.key = makeSortKey(LayerOpaque, sheetProgram.id, gravitySheet.VAO);
+            sheet.program = sheetProgram.id;
+            sheet.vertexArray = gravitySheet.VAO;
+            sheet.kind = DrawElements;
+            sheet.primitive = GL_LINES;
+            sheet.count = gravitySheet.indexCount;
+            sheet.indexType = GL_UNSIGNED_INT;
+            sheet.gpuPass = GpuPassGrid;
+            submitDraw(renderQueue, sheet);
+        } else {
+            DrawItem grid;
+            grid.key = makeSortKey(LayerOpaque, lineProgram.id, gridVAO);
+            grid.program = lineProgram.id;
+            grid.vertexArray = gridVAO;
+            grid.primitive = GL_LINES;
+            grid.count = (int)(gridVertices.size() / 3);
+            grid.gpuPass = GpuPassGrid;
+            submitDraw(renderQueue, grid);
+        }
+        
+        recordPhase(profiler, PhaseSubmit, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count());
+        
+        {
+            ScopedPhaseTimer timer(profiler, PhaseFlush);
+            TRACE_ZONE("flush");
+            flushRenderQueue(renderQueue, stateCache, &gpuTimers);
+            
+            if (renderMode == RenderSplat) {
+                drawSplatTonemap(renderQueue, stateCache, tonemapProgram.id, emptyVAO, splatTarget);
+            }
+        }
+        
+        if (showPerfOverlay) {
+            // Rebuilt a few times a second so the numbers stay readable
+            if (currentTime - perfTextRefresh >= 0.25) {
+                perfTextRefresh = currentTime;
+                buildPerfText(perfText, profiler, statsPerFrame, countersFile ? &lastStep : nullptr);
+                recordUpload(stateCache, uploadText(perfText));
+            }
+            useProgram(stateCache, textProgram.id);
+            setUniformVec2(stateCache, textProgram.id, textViewportSizeLocation, glm::vec2((float)windowWidth, (float)windowHeight));
+            drawTextOverlay(renderQueue, stateCache, textProgram.id, perfText);
+        }
+        
+        // Keeps the CPU from overwriting this frame's instances until the draws have read them
+        fenceStreamWrite(sphereInstances);
+        
+        statsTotal.drawCalls += stateCache.stats.drawCalls;
+        statsTotal.programBinds += stateCache.stats.programBinds;
+        statsTotal.vertexArrayBinds += stateCache.stats.vertexArrayBinds;
+        statsTotal.uniformUploads += stateCache.stats.uniformUploads;
+        statsTotal.instanceBinds += stateCache.stats.instanceBinds;
+        statsTotal.bytesUploaded += stateCache.stats.bytesUploaded;
+        stateCache.stats = RenderStats();
+        statsFrames++;
+        if (currentTime - statsStart >= 1.0) {
+            uint64_t stepCount = replayPath ? 0 : snapshotReadSlot(sim.snapshots).stepCount;
+            std::string title = "Physics Sim | " + std::to_string(statsFrames) + " fps, " +
+                std::to_string(stepCount - statsStepCount) + " sim steps/s, " +
+                std::to_string(lightClusters.lightCount) + " lights | " +
+                std::to_string(statsTotal.drawCalls / statsFrames) + " draws, " +
+                std::to_string(statsTotal.stateChanges() / statsFrames) + " state changes, " +
+                std::to_string(statsTotal.bytesUploaded / statsFrames) + " bytes uploaded per frame";
+            glfwSetWindowTitle(window, title.c_str());
+            
+            statsPerFrame.drawCalls = statsTotal.drawCalls / statsFrames;
+            statsPerFrame.programBinds = statsTotal.programBinds / statsFrames;
+            statsPerFrame.vertexArrayBinds = statsTotal.vertexArrayBinds / statsFrames;
+            statsPerFrame.uniformUploads = statsTotal.uniformUploads / statsFrames;
+            statsPerFrame.instanceBinds = statsTotal.instanceBinds / statsFrames;
+            statsPerFrame.bytesUploaded = statsTotal.bytesUploaded / statsFrames;
+            statsTotal = RenderStats();
+            statsFrames = 0;
+            statsStart = currentTime;
+            statsStepCount = stepCount;
+        }
 
-		glUseProgram(shaderProgram);
+        if (traceWriteRequest) {
+            traceWriteRequest = false;
+            const char* path = tracePath ? tracePath : "trace.json";
+            long zoneCount = writeChromeTrace(path);
+            if (zoneCount >= 0) std::cout << "Wrote " << zoneCount << " trace zones to " << path << std::endl;
+        }
+        
         // Swap buffers and poll events
+        ScopedPhaseTimer timer(profiler, PhaseSwap);
+        TRACE_ZONE("swap");
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
     
+    stopSimThread(sim);
+    
+    if (tracePath && tracingEnabled) {
+        long zoneCount = writeChromeTrace(tracePath);
+        if (zoneCount >= 0) std::cout << "Wrote " << zoneCount << " trace zones to " << tracePath << std::endl;
+    }
+    
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteProgram(shaderProgram);
+    for (SphereLOD& lod : sphereLODs) {
+        destroySphereLOD(lod);
+    }
+    destroyStreamBuffer(sphereInstances);
 	glDeleteVertexArrays(1, &gridVAO);
 	glDeleteBuffers(1, &gridVBO);
-	glDeleteProgram(lineShaderProgram);
+    glDeleteVertexArrays(1, &impostorVAO);
+    glDeleteBuffers(1, &impostorVBO);
+    glDeleteVertexArrays(1, &splatVAO);
+    glDeleteVertexArrays(1, &emptyVAO);
+    if (splatTarget.framebuffer) destroySplatTarget(splatTarget);
+    if (trails.positionBuffer) destroyTrailBuffer(trails);
+    destroyLightClusters(lightClusters);
+    destroyTextOverlay(perfText);
+    destroyGpuTimers(gpuTimers);
+    stopPotentialWorker(sheetWorker);
+    destroyGravitySheet(gravitySheet);
+    destroyPrograms(programs);
+    glDeleteBuffers(1, &frameUBO);
     glfwTerminate();
+    
+    if (recorder.file) closeTrajectoryWriter(recorder);
+    if (countersFile) std::fclose(countersFile);
+    if (replayPath) closeTrajectoryReader(replay);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "mapped_file.h"
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool openMappedFile(MappedFile& file, const char* path) {
+    HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        std::cerr << "ERROR: Could not open " << path << std::endl;
+        return false;
+    }
+    
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        std::cerr << "ERROR: " << path << " is empty or unreadable" << std::endl;
+        CloseHandle(fileHandle);
+        return false;
+    }
+    
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mappingHandle) {
+        std::cerr << "ERROR: Could not map " << path << std::endl;
+        CloseHandle(fileHandle);
+        return false;
+    }
+    
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        std::cerr << "ERROR: Could not map " << path << std::endl;
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+    
+    file.data = static_cast<const unsigned char*>(view);
+    file.size = (size_t)fileSize.QuadPart;
+    file.fileHandle = fileHandle;
+    file.mappingHandle = mappingHandle;
+    return true;
+}
+
+void closeMappedFile(MappedFile& file) {
+    if (file.data) UnmapViewOfFile(file.data);
+    if (file.mappingHandle) CloseHandle(file.mappingHandle);
+    if (file.fileHandle) CloseHandle(file.fileHandle);
+    file = MappedFile();
+}
+
+void prefetchMappedRange(const MappedFile& file, size_t offset, size_t length) {
+    (void)file;
+    (void)offset;
+    (void)length;
+}
+
+#else
+
+bool openMappedFile(MappedFile& file, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "ERROR: Could not open " << path << std::endl;
+        return false;
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "ERROR: " << path << " is empty or unreadable" << std::endl;
+        close(fd);
+        return false;
+    }
+    
+    void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        std::cerr << "ERROR: Could not map " << path << std::endl;
+        close(fd);
+        return false;
+    }
+    
+    file.data = static_cast<const unsigned char*>(view);
+    file.size = (size_t)info.st_size;
+    file.fd = fd;
+    return true;
+}
+
+void closeMappedFile(MappedFile& file) {
+    if (file.data) munmap(const_cast<unsigned char*>(file.data), file.size);
+    if (file.fd >= 0) close(file.fd);
+    file = MappedFile();
+}
+
+void prefetchMappedRange(const MappedFile& file, size_t offset, size_t length) {
+    if (!file.data || offset >= file.size) return;
+    if (length > file.size - offset) length = file.size - offset;
+    
+    // madvise wants a page-aligned start
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignedOffset = offset - offset % pageSize;
+    madvise(const_cast<unsigned char*>(file.data) + alignedOffset, length + (offset - alignedOffset), MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are only read from disk
+// when they are first touched, so large files cost nothing up front.
+struct MappedFile {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+bool openMappedFile(MappedFile& file, const char* path);
+void closeMappedFile(MappedFile& file);
+
+// Hint that [offset, offset + length) will be read soon (no-op where unsupported)
+void prefetchMappedRange(const MappedFile& file, size_t offset, size_t length);
@@ -0,0 +1,183 @@
+#include "mesh_gen.h"
+#include <cmath>
+#include <unordered_map>
+
+// Evaluated by the compiler; only the finished arrays end up in the binary
+static constexpr auto uvSphere30 = makeUVSphere<30, 30>();
+static constexpr auto uvSphere16 = makeUVSphere<16, 16>();
+static constexpr auto uvSphere8 = makeUVSphere<8, 8>();
+static constexpr auto uvSphere4 = makeUVSphere<4, 4>();
+
+static constexpr auto icosphere0 = makeIcosphere<0>();
+static constexpr auto icosphere1 = makeIcosphere<1>();
+static constexpr auto icosphere2 = makeIcosphere<2>();
+static constexpr auto icosphere3 = makeIcosphere<3>();
+
+bool bakedUVSphere(int resolution, MeshView& mesh) {
+    switch (resolution) {
+    case 30: mesh = uvSphere30.view(); return true;
+    case 16: mesh = uvSphere16.view(); return true;
+    case 8: mesh = uvSphere8.view(); return true;
+    case 4: mesh = uvSphere4.view(); return true;
+    }
+    return false;
+}
+
+bool bakedIcosphere(int level, MeshView& mesh) {
+    switch (level) {
+    case 0: mesh = icosphere0.view(); return true;
+    case 1: mesh = icosphere1.view(); return true;
+    case 2: mesh = icosphere2.view(); return true;
+    case 3: mesh = icosphere3.view(); return true;
+    }
+    return false;
+}
+
+void generateUVSphere(int latRes, int lonRes, std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+    const double PI = 3.14159265358979323846;
+    if (latRes <= 0 || lonRes <= 0) {
+        vertices.clear();
+        indices.clear();
+        return;
+    }
+    vertices.resize((size_t)(latRes + 1) * (lonRes + 1) * meshVertexFloats);
+    indices.resize((size_t)latRes * lonRes * 6);
+
+    // Longitude ring, shared by every latitude: rotate (cos, sin) by a fixed
+    // step instead of calling cos/sin per vertex
+    std::vector<float> ringCos(lonRes + 1), ringSin(lonRes + 1);
+    double stepCos = std::cos(2.0 * PI / lonRes), stepSin = std::sin(2.0 * PI / lonRes);
+    double c = 1.0, s = 0.0;
+    for (int lon = 0; lon <= lonRes; ++lon) {
+        ringCos[lon] = (float)c;
+        ringSin[lon] = (float)s;
+        double next = c * stepCos - s * stepSin;
+        s = s * stepCos + c * stepSin;
+        c = next;
+    }
+    // Close the seam exactly despite rounding in the recurrence
+    ringCos[lonRes] = 1.0f;
+    ringSin[lonRes] = 0.0f;
+
+    double latStepCos = std::cos(PI / latRes), latStepSin = std::sin(PI / latRes);
+    double cosTheta = 1.0, sinTheta = 0.0;
+    float* out = vertices.data();
+    for (int lat = 0; lat <= latRes; ++lat) {
+        if (lat == latRes) {
+            cosTheta = -1.0;
+            sinTheta = 0.0;
+        }
+        for (int lon = 0; lon <= lonRes; ++lon) {
+            float x = (float)(ringCos[lon] * sinTheta);
+            float y = (float)cosTheta;
+            float z = (float)(ringSin[lon] * sinTheta);
+            *out++ = x;
+            *out++ = y;
+            *out++ = z;
+            *out++ = x;
+            *out++ = y;
+            *out++ = z;
+        }
+        double next = cosTheta * latStepCos - sinTheta * latStepSin;
+        sinTheta = sinTheta * latStepCos + cosTheta * latStepSin;
+        cosTheta = next;
+    }
+
+    uint32_t* index = indices.data();
+    for (int lat = 0; lat < latRes; ++lat) {
+        for (int lon = 0; lon < lonRes; ++lon) {
+            uint32_t first = lat * (lonRes + 1) + lon;
+            uint32_t second = first + lonRes + 1;
+            *index++ = first;
+            *index++ = second;
+            *index++ = first + 1;
+            *index++ = second;
+            *index++ = second + 1;
+            *index++ = first + 1;
+        }
+    }
+}
+
+void generateIcosphere(int level, std::vector<float>& vertices, std::vector<uint32_t>& indices) {
+    MeshView baked;
+    if (bakedIcosphere(level, baked)) {
+        vertices.assign(baked.vertices, baked.vertices + baked.vertexCount * meshVertexFloats);
+        indices.assign(baked.indices, baked.indices + baked.indexCount);
+        return;
+    }
+
+    size_t vertexCount = icosphereVertexCount(level);
+    std::vector<double> positions;
+    positions.reserve(vertexCount * 3);
+    for (const auto& corner : icosahedronCorners) {
+        double length = std::sqrt(corner[0] * corner[0] + corner[1] * corner[1] + corner[2] * corner[2]);
+        positions.push_back(corner[0] / length);
+        positions.push_back(corner[1] / length);
+        positions.push_back(corner[2] / length);
+    }
+    indices.assign(icosahedronFaces, icosahedronFaces + 60);
+
+    // Same subdivision order as makeIcosphere, so both number vertices alike
+    std::vector<uint32_t> nextIndices;
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    for (int step = 0; step < level; ++step) {
+        midpoints.clear();
+        midpoints.reserve(indices.size() / 2);
+        nextIndices.clear();
+        nextIndices.reserve(indices.size() * 4);
+        for (size_t f = 0; f < indices.size(); f += 3) {
+            uint32_t mid[3];
+            for (int e = 0; e < 3; ++e) {
+                uint32_t a = indices[f + e];
+                uint32_t b = indices[f + (e + 1) % 3];
+                uint64_t key = a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+                auto inserted = midpoints.emplace(key, (uint32_t)(positions.size() / 3));
+                if (inserted.second) {
+                    double x = positions[a * 3] + positions[b * 3];
+                    double y = positions[a * 3 + 1] + positions[b * 3 + 1];
+                    double z = positions[a * 3 + 2] + positions[b * 3 + 2];
+                    double length = std::sqrt(x * x + y * y + z * z);
+                    positions.push_back(x / length);
+                    positions.push_back(y / length);
+                    positions.push_back(z / length);
+                }
+                mid[e] = inserted.first->second;
+            }
+
+            uint32_t v0 = indices[f], v1 = indices[f + 1], v2 = indices[f + 2];
+            const uint32_t split[12] = {v0, mid[0], mid[2],  v1, mid[1], mid[0],
+                                        v2, mid[2], mid[1],  mid[0], mid[1], mid[2]};
+            nextIndices.insert(nextIndices.end(), split, split + 12);
+        }
+        indices.swap(nextIndices);
+    }
+
+    vertices.resize(vertexCount * meshVertexFloats);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        for (int c = 0; c < 3; ++c) {
+            vertices[v * 6 + c] = (float)positions[v * 3 + c];
+            vertices[v * 6 + 3 + c] = (float)positions[v * 3 + c];
+        }
+    }
+}
+
+std::vector<float> generateGridVertices(int size, float spacing) {
+    std::vector<float> gridVertices;
+    gridVertices.reserve((size_t)size * 4 * 3);
+    float halfSize = (size - 1) * spacing * 0.5f;
+
+    // Lines along the X axis
+    for (int i = 0; i < size; ++i) {
+        float z = -halfSize + i * spacing;
+        gridVertices.insert(gridVertices.end(), {-halfSize, 0.0f, z});
+        gridVertices.insert(gridVertices.end(), {halfSize, 0.0f, z});
+    }
+
+    // Lines along the Z axis
+    for (int i = 0; i < size; ++i) {
+        float x = -halfSize + i * spacing;
+        gridVertices.insert(gridVertices.end(), {x, 0.0f, -halfSize});
+        gridVertices.insert(gridVertices.end(), {x, 0.0f, halfSize});
+    }
+    return gridVertices;
+}
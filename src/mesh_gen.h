@@ -0,0 +1,270 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Primitive mesh generation.
+//
+// The templates below are constexpr: instantiated into a constexpr variable
+// they run in the compiler and the vertex/index data is stored in the binary,
+// so fixed-resolution meshes cost nothing at startup and never touch the
+// heap. Called at runtime they build the whole mesh in std::arrays on the
+// stack, which is fine for the small meshes they are meant for but not for
+// fine icospheres (hundreds of KB from level 5). Resolutions only known at
+// runtime go through generateUVSphere, which uses sin/cos recurrences
+// instead of one sin/cos pair per vertex, and generateIcosphere, which
+// builds on the heap.
+//
+// Vertices are 6 floats: position (3) then normal (3). Sphere meshes have
+// unit radius, so each normal equals its position.
+
+const int meshVertexFloats = 6;
+
+// Borrowed view of mesh data, baked or generated
+struct MeshView {
+    const float* vertices;
+    size_t vertexCount;
+    const uint16_t* indices;
+    size_t indexCount;
+};
+
+template <size_t VertexCount, size_t IndexCount>
+struct StaticMesh {
+    std::array<float, VertexCount * meshVertexFloats> vertices{};
+    std::array<uint16_t, IndexCount> indices{};
+
+    MeshView view() const { return {vertices.data(), VertexCount, indices.data(), IndexCount}; }
+};
+
+namespace meshmath {
+
+constexpr double pi = 3.14159265358979323846;
+
+// Taylor series after reducing to [-pi, pi]; accurate to ~1e-15
+constexpr double sin(double x) {
+    while (x > pi) x -= 2.0 * pi;
+    while (x < -pi) x += 2.0 * pi;
+    double term = x, sum = x;
+    for (int n = 1; n < 14; ++n) {
+        term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cos(double x) {
+    return sin(x + 0.5 * pi);
+}
+
+constexpr double sqrt(double x) {
+    if (x <= 0.0) return 0.0;
+    double guess = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 64; ++i) {
+        double next = 0.5 * (guess + x / guess);
+        if (next == guess) break;
+        guess = next;
+    }
+    return guess;
+}
+
+} // namespace meshmath
+
+// ---------------------------------------------------------------------------
+// UV sphere: (LatRes + 1) x (LonRes + 1) vertices, seam duplicated
+
+template <int LatRes, int LonRes>
+constexpr StaticMesh<(LatRes + 1) * (LonRes + 1), LatRes * LonRes * 6> makeUVSphere() {
+    static_assert((LatRes + 1) * (LonRes + 1) <= 65536, "UV sphere too fine for 16-bit indices");
+    StaticMesh<(LatRes + 1) * (LonRes + 1), LatRes * LonRes * 6> mesh;
+
+    size_t v = 0;
+    for (int lat = 0; lat <= LatRes; ++lat) {
+        double theta = meshmath::pi * lat / LatRes;
+        double sinTheta = meshmath::sin(theta);
+        double cosTheta = meshmath::cos(theta);
+        for (int lon = 0; lon <= LonRes; ++lon) {
+            double phi = 2.0 * meshmath::pi * lon / LonRes;
+            float x = (float)(meshmath::cos(phi) * sinTheta);
+            float y = (float)cosTheta;
+            float z = (float)(meshmath::sin(phi) * sinTheta);
+            mesh.vertices[v++] = x;
+            mesh.vertices[v++] = y;
+            mesh.vertices[v++] = z;
+            mesh.vertices[v++] = x;
+            mesh.vertices[v++] = y;
+            mesh.vertices[v++] = z;
+        }
+    }
+
+    size_t i = 0;
+    for (int lat = 0; lat < LatRes; ++lat) {
+        for (int lon = 0; lon < LonRes; ++lon) {
+            uint16_t first = (uint16_t)(lat * (LonRes + 1) + lon);
+            uint16_t second = (uint16_t)(first + LonRes + 1);
+            mesh.indices[i++] = first;
+            mesh.indices[i++] = second;
+            mesh.indices[i++] = (uint16_t)(first + 1);
+            mesh.indices[i++] = second;
+            mesh.indices[i++] = (uint16_t)(second + 1);
+            mesh.indices[i++] = (uint16_t)(first + 1);
+        }
+    }
+    return mesh;
+}
+
+// ---------------------------------------------------------------------------
+// Icosphere: an icosahedron with every triangle split in four `Level` times
+// and the new vertices pushed out to the unit sphere. Shared edge midpoints
+// are reused, so level L has 10 * 4^L + 2 vertices and 20 * 4^L triangles.
+
+// Icosahedron from three orthogonal golden rectangles
+constexpr double icosahedronRatio = (1.0 + meshmath::sqrt(5.0)) / 2.0;
+constexpr double icosahedronCorners[12][3] = {
+    {-1, icosahedronRatio, 0}, {1, icosahedronRatio, 0}, {-1, -icosahedronRatio, 0}, {1, -icosahedronRatio, 0},
+    {0, -1, icosahedronRatio}, {0, 1, icosahedronRatio}, {0, -1, -icosahedronRatio}, {0, 1, -icosahedronRatio},
+    {icosahedronRatio, 0, -1}, {icosahedronRatio, 0, 1}, {-icosahedronRatio, 0, -1}, {-icosahedronRatio, 0, 1}};
+constexpr uint16_t icosahedronFaces[60] = {
+    0, 11, 5,  0, 5, 1,  0, 1, 7,  0, 7, 10,  0, 10, 11,
+    1, 5, 9,  5, 11, 4,  11, 10, 2,  10, 7, 6,  7, 1, 8,
+    3, 9, 4,  3, 4, 2,  3, 2, 6,  3, 6, 8,  3, 8, 9,
+    4, 9, 5,  2, 4, 11,  6, 2, 10,  8, 6, 7,  9, 8, 1};
+
+constexpr size_t icosphereVertexCount(int level) {
+    size_t faces = 20;
+    for (int i = 0; i < level; ++i) faces *= 4;
+    return faces / 2 + 2;
+}
+
+constexpr size_t icosphereIndexCount(int level) {
+    size_t faces = 20;
+    for (int i = 0; i < level; ++i) faces *= 4;
+    return faces * 3;
+}
+
+template <int Level>
+constexpr StaticMesh<icosphereVertexCount(Level), icosphereIndexCount(Level)> makeIcosphere() {
+    constexpr size_t vertexCount = icosphereVertexCount(Level);
+    constexpr size_t indexCount = icosphereIndexCount(Level);
+    static_assert(vertexCount <= 65536, "Icosphere too fine for 16-bit indices");
+
+    std::array<double, vertexCount * 3> positions{};
+    std::array<uint16_t, indexCount> faces{};
+    std::array<uint16_t, indexCount> nextFaces{};
+
+    size_t count = 0;
+    for (const auto& corner : icosahedronCorners) {
+        double length = meshmath::sqrt(corner[0] * corner[0] + corner[1] * corner[1] + corner[2] * corner[2]);
+        positions[count * 3] = corner[0] / length;
+        positions[count * 3 + 1] = corner[1] / length;
+        positions[count * 3 + 2] = corner[2] / length;
+        count++;
+    }
+    size_t faceIndices = 60;
+    for (size_t i = 0; i < faceIndices; ++i) faces[i] = icosahedronFaces[i];
+
+    for (int level = 0; level < Level; ++level) {
+        // Midpoints created this level, keyed by their edge's endpoints
+        std::array<uint32_t, indexCount / 2> edgeKeys{};
+        std::array<uint16_t, indexCount / 2> edgeMidpoints{};
+        size_t edgeCount = 0;
+
+        size_t out = 0;
+        for (size_t f = 0; f < faceIndices; f += 3) {
+            uint16_t mid[3] = {};
+            for (int e = 0; e < 3; ++e) {
+                uint16_t a = faces[f + e];
+                uint16_t b = faces[f + (e + 1) % 3];
+                uint32_t key = a < b ? ((uint32_t)a << 16 | b) : ((uint32_t)b << 16 | a);
+
+                size_t found = edgeCount;
+                for (size_t k = 0; k < edgeCount; ++k) {
+                    if (edgeKeys[k] == key) {
+                        found = k;
+                        break;
+                    }
+                }
+                if (found == edgeCount) {
+                    double x = positions[a * 3] + positions[b * 3];
+                    double y = positions[a * 3 + 1] + positions[b * 3 + 1];
+                    double z = positions[a * 3 + 2] + positions[b * 3 + 2];
+                    double length = meshmath::sqrt(x * x + y * y + z * z);
+                    positions[count * 3] = x / length;
+                    positions[count * 3 + 1] = y / length;
+                    positions[count * 3 + 2] = z / length;
+                    edgeKeys[edgeCount] = key;
+                    edgeMidpoints[edgeCount] = (uint16_t)count;
+                    edgeCount++;
+                    count++;
+                }
+                mid[e] = edgeMidpoints[found];
+            }
+
+            uint16_t v0 = faces[f], v1 = faces[f + 1], v2 = faces[f + 2];
+            const uint16_t split[12] = {v0, mid[0], mid[2],  v1, mid[1], mid[0],
+                                        v2, mid[2], mid[1],  mid[0], mid[1], mid[2]};
+            for (uint16_t index : split) nextFaces[out++] = index;
+        }
+        faceIndices = out;
+        for (size_t i = 0; i < faceIndices; ++i) faces[i] = nextFaces[i];
+    }
+
+    StaticMesh<vertexCount, indexCount> mesh;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        for (int c = 0; c < 3; ++c) {
+            mesh.vertices[v * 6 + c] = (float)positions[v * 3 + c];
+            mesh.vertices[v * 6 + 3 + c] = (float)positions[v * 3 + c];
+        }
+    }
+    for (size_t i = 0; i < indexCount; ++i) mesh.indices[i] = faces[i];
+    return mesh;
+}
+
+// ---------------------------------------------------------------------------
+// Reference grid: Size lines along x then Size lines along z, centered on
+// the origin in the XZ plane, as GL_LINES endpoints (3 floats each)
+
+template <int Size>
+constexpr std::array<float, Size * 4 * 3> makeGridLines(float spacing) {
+    std::array<float, Size * 4 * 3> lines{};
+    float halfSize = (Size - 1) * spacing * 0.5f;
+    size_t v = 0;
+    for (int axis = 0; axis < 2; ++axis) {
+        for (int i = 0; i < Size; ++i) {
+            float offset = -halfSize + i * spacing;
+            float ends[2] = {-halfSize, halfSize};
+            for (float end : ends) {
+                lines[v++] = axis == 0 ? end : offset;
+                lines[v++] = 0.0f;
+                lines[v++] = axis == 0 ? offset : end;
+            }
+        }
+    }
+    return lines;
+}
+
+// ---------------------------------------------------------------------------
+// Baked meshes and runtime generation (mesh_gen.cpp)
+
+// The UV sphere baked at `resolution` (30, 16, 8 or 4 segments in both
+// directions, the sphere LOD chain), or false if none is baked
+bool bakedUVSphere(int resolution, MeshView& mesh);
+
+// Icospheres baked for levels 0 through bakedIcosphereMaxLevel. The renderer
+// draws UV spheres, so these only back generateIcosphere (and the benches).
+const int bakedIcosphereMaxLevel = 3;
+bool bakedIcosphere(int level, MeshView& mesh);
+
+// UV sphere at any resolution. Each ring's sines and cosines come from an
+// angle-addition recurrence, so a mesh costs two sin/cos pairs in total.
+// A resolution of zero or less in either direction gives an empty mesh.
+void generateUVSphere(int latRes, int lonRes, std::vector<float>& vertices, std::vector<uint32_t>& indices);
+
+// Icosphere at any level, laid out exactly like makeIcosphere<level>.
+// Baked levels are copied; finer ones are subdivided on the heap with a
+// hash map of edge midpoints, so any level that fits in memory works.
+void generateIcosphere(int level, std::vector<float>& vertices, std::vector<uint32_t>& indices);
+
+// Reference grid of any size and spacing, laid out like makeGridLines
+std::vector<float> generateGridVertices(int size, float spacing);
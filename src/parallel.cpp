@@ -0,0 +1,120 @@
+#include "parallel.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// One runParallelChunks call. It lives on the caller's stack, so workers
+// only touch it while it has chunks unfinished (the caller waits for those).
+struct ParallelJob {
+    void (*run)(void* context, unsigned int chunk);
+    void* context;
+    const ChunkHooks* hooks;
+    unsigned int chunkCount;
+    unsigned int nextChunk = 0;
+    unsigned int finishedChunks = 0;
+};
+
+struct WorkerPool {
+    std::mutex mutex;
+    std::condition_variable wake;           // A job was queued
+    std::condition_variable jobFinished;    // Some job's last chunk finished
+    std::deque<ParallelJob*> jobs;          // Jobs with chunks nobody has claimed yet
+    std::vector<std::thread> workers;
+    std::vector<int> workerThreadIds;
+};
+
+static thread_local const ChunkHooks* threadChunkHooks = nullptr;
+
+// Claim the next chunk of the front job; the job leaves the queue with its
+// last chunk. Called with the pool locked.
+static unsigned int claimChunk(WorkerPool& pool, ParallelJob& job) {
+    unsigned int chunk = job.nextChunk++;
+    if (job.nextChunk == job.chunkCount) {
+        for (auto it = pool.jobs.begin(); it != pool.jobs.end(); ++it) {
+            if (*it == &job) {
+                pool.jobs.erase(it);
+                break;
+            }
+        }
+    }
+    return chunk;
+}
+
+// Run one chunk with the pool unlocked, then count it
+static void runChunk(WorkerPool& pool, std::unique_lock<std::mutex>& lock, ParallelJob& job, unsigned int chunk) {
+    lock.unlock();
+    if (job.hooks) job.hooks->begin(job.hooks->context);
+    job.run(job.context, chunk);
+    if (job.hooks) job.hooks->end(job.hooks->context);
+    lock.lock();
+    if (++job.finishedChunks == job.chunkCount) pool.jobFinished.notify_all();
+}
+
+static void runWorker(WorkerPool& pool) {
+    std::unique_lock<std::mutex> lock(pool.mutex);
+#ifdef __linux__
+    // parallelWorkerThreadIds waits on jobFinished for every worker to get here
+    pool.workerThreadIds.push_back((int)syscall(SYS_gettid));
+    pool.jobFinished.notify_all();
+#endif
+    for (;;) {
+        pool.wake.wait(lock, [&] { return !pool.jobs.empty(); });
+        ParallelJob& job = *pool.jobs.front();
+        runChunk(pool, lock, job, claimChunk(pool, job));
+    }
+}
+
+// Never destroyed: the workers block until the process exits, and joining
+// them from a static destructor would race other statics' teardown
+static WorkerPool& workerPool() {
+    static WorkerPool* pool = [] {
+        WorkerPool* pool = new WorkerPool();
+        unsigned int workerCount = hardwareThreadCount() - 1;
+        pool->workers.reserve(workerCount);
+        for (unsigned int i = 0; i < workerCount; ++i) {
+            pool->workers.emplace_back(runWorker, std::ref(*pool));
+        }
+        return pool;
+    }();
+    return *pool;
+}
+
+void runParallelChunks(unsigned int chunkCount, void (*run)(void* context, unsigned int chunk), void* context) {
+    WorkerPool& pool = workerPool();
+    ParallelJob job;
+    job.run = run;
+    job.context = context;
+    job.hooks = threadChunkHooks;
+    job.chunkCount = chunkCount;
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.jobs.push_back(&job);
+    if (chunkCount > 2) {
+        pool.wake.notify_all();
+    } else {
+        pool.wake.notify_one();
+    }
+
+    while (job.nextChunk < job.chunkCount) {
+        runChunk(pool, lock, job, claimChunk(pool, job));
+    }
+    pool.jobFinished.wait(lock, [&] { return job.finishedChunks == job.chunkCount; });
+}
+
+void setChunkHooks(const ChunkHooks* hooks) {
+    threadChunkHooks = hooks;
+}
+
+std::vector<int> parallelWorkerThreadIds() {
+    WorkerPool& pool = workerPool();
+    std::unique_lock<std::mutex> lock(pool.mutex);
+#ifdef __linux__
+    pool.jobFinished.wait(lock, [&] { return pool.workerThreadIds.size() == pool.workers.size(); });
+#endif
+    return pool.workerThreadIds;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of hardware threads, never less than one
+inline unsigned int hardwareThreadCount() {
+    unsigned int count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+// Run(context, chunk) for chunk 0 .. chunkCount-1 on the worker pool and the
+// calling thread, returning once every chunk has finished. The pool has
+// hardwareThreadCount() - 1 threads, started on first use; they sleep
+// between calls and live until the process exits. Calls from several
+// threads at once queue behind each other on the workers, and the caller
+// always works through its own chunks too, so a call never waits on a busy
+// pool to start.
+void runParallelChunks(unsigned int chunkCount, void (*run)(void* context, unsigned int chunk), void* context);
+
+// Calls made around every chunk of the jobs one thread starts, on whichever
+// thread runs the chunk (the starting thread included), e.g. to count only
+// that thread's work on the shared pool
+struct ChunkHooks {
+    void (*begin)(void* context);
+    void (*end)(void* context);
+    void* context;
+};
+
+// Run `hooks` around the chunks of every runParallelChunks call the calling
+// thread makes from now on; null stops. They must outlive those calls.
+void setChunkHooks(const ChunkHooks* hooks);
+
+// Linux thread IDs of the pool's workers (starting the pool if it is not
+// running yet); empty on other platforms
+std::vector<int> parallelWorkerThreadIds();
+
+// Split [begin, end) into `chunkCount` contiguous chunks and run
+// fn(chunkBegin, chunkEnd, chunkIndex) for each one on the worker pool.
+// Chunks beyond the pool's size wait for a free thread rather than getting
+// one of their own.
+template <typename Function>
+void parallelFor(size_t begin, size_t end, unsigned int chunkCount, Function fn) {
+    size_t count = end > begin ? end - begin : 0;
+    if (chunkCount == 0) chunkCount = 1;
+    if (count < chunkCount) chunkCount = count ? (unsigned int)count : 1;
+
+    if (chunkCount == 1) {
+        fn(begin, end, 0u);
+        return;
+    }
+
+    struct Range {
+        size_t begin;
+        size_t count;
+        unsigned int chunkCount;
+        Function* fn;
+    } range = {begin, count, chunkCount, &fn};
+    runParallelChunks(chunkCount, [](void* context, unsigned int chunk) {
+        Range& range = *static_cast<Range*>(context);
+        size_t chunkBegin = range.begin + range.count * chunk / range.chunkCount;
+        size_t chunkEnd = range.begin + range.count * (chunk + 1) / range.chunkCount;
+        (*range.fn)(chunkBegin, chunkEnd, chunk);
+    }, &range);
+}
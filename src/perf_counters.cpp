@@ -0,0 +1,154 @@
+#include "perf_counters.h"
+#include "parallel.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* const perfCounterNames[CounterCount] = {
+    "cycles", "instructions", "L1d misses", "LLC misses", "branch misses"};
+
+#ifdef __linux__
+
+// (type, config) of every PerfCounter
+static const uint32_t counterTypes[CounterCount] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+static const uint64_t counterConfigs[CounterCount] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES};
+
+// Enable or disable the calling thread's counters if it is a worker; the
+// opening thread's own counters always run
+static void switchWorkerCounters(const PerfCounters& counters, unsigned long request) {
+    static thread_local int threadId = (int)syscall(SYS_gettid);
+    for (size_t thread = 1; thread < counters.threadIds.size(); ++thread) {
+        if (counters.threadIds[thread] != threadId) continue;
+        for (const std::vector<int>& fds : counters.fds) {
+            if (!fds.empty()) ioctl(fds[thread], request, 0);
+        }
+        return;
+    }
+}
+
+static void beginCountedChunk(void* context) {
+    switchWorkerCounters(*static_cast<const PerfCounters*>(context), PERF_EVENT_IOC_ENABLE);
+}
+
+static void endCountedChunk(void* context) {
+    switchWorkerCounters(*static_cast<const PerfCounters*>(context), PERF_EVENT_IOC_DISABLE);
+}
+
+bool openPerfCounters(PerfCounters& counters) {
+    // This thread and each pool worker, on whichever CPU they run
+    counters.threadIds = parallelWorkerThreadIds();
+    counters.threadIds.insert(counters.threadIds.begin(), (int)syscall(SYS_gettid));
+
+    int opened = 0;
+    for (int counter = 0; counter < CounterCount; ++counter) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counterTypes[counter];
+        attr.config = counterConfigs[counter];
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        // A counter only counts if it can be opened on every thread. Workers
+        // start disabled and only count this thread's chunks.
+        for (size_t thread = 0; thread < counters.threadIds.size(); ++thread) {
+            attr.disabled = thread > 0;
+            int fd = (int)syscall(SYS_perf_event_open, &attr, counters.threadIds[thread], -1, -1, 0);
+            if (fd < 0) {
+                std::cerr << "WARNING: Counter " << perfCounterNames[counter] << " unavailable: "
+                          << std::strerror(errno) << std::endl;
+                for (int fd : counters.fds[counter]) close(fd);
+                counters.fds[counter].clear();
+                break;
+            }
+            counters.fds[counter].push_back(fd);
+        }
+        if (!counters.fds[counter].empty()) opened++;
+    }
+    if (opened == 0) {
+        std::cerr << "ERROR: No hardware counters could be opened (check /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+        return false;
+    }
+    counters.workerHooks = {beginCountedChunk, endCountedChunk, &counters};
+    setChunkHooks(&counters.workerHooks);
+    return true;
+}
+
+void closePerfCounters(PerfCounters& counters) {
+    setChunkHooks(nullptr);
+    for (std::vector<int>& fds : counters.fds) {
+        for (int fd : fds) close(fd);
+        fds.clear();
+    }
+}
+
+void readPerfCounters(const PerfCounters& counters, PerfCounterSample& sample) {
+    sample = PerfCounterSample();
+    for (int counter = 0; counter < CounterCount; ++counter) {
+        if (counters.fds[counter].empty()) continue;
+
+        uint64_t total = 0;
+        bool complete = true;
+        for (int fd : counters.fds[counter]) {
+            // value, time enabled, time running. A thread that has not run
+            // since the counter opened reads zero for all three.
+            uint64_t data[3];
+            if (read(fd, data, sizeof(data)) != (ssize_t)sizeof(data)) {
+                complete = false;
+                break;
+            }
+            if (data[2] == 0) continue;
+            double scale = data[2] < data[1] ? (double)data[1] / (double)data[2] : 1.0;
+            total += (uint64_t)(data[0] * scale);
+        }
+        if (!complete) continue;
+        sample.values[counter] = total;
+        sample.available |= 1u << counter;
+    }
+}
+
+#else
+
+bool openPerfCounters(PerfCounters& counters) {
+    std::cerr << "ERROR: Hardware counters need Linux perf_event_open" << std::endl;
+    return false;
+}
+
+void closePerfCounters(PerfCounters& counters) {}
+
+void readPerfCounters(const PerfCounters& counters, PerfCounterSample& sample) {
+    sample = PerfCounterSample();
+}
+
+#endif
+
+PerfCounterSample perfCounterDelta(const PerfCounterSample& begin, const PerfCounterSample& end) {
+    PerfCounterSample delta;
+    delta.available = begin.available & end.available;
+    for (int counter = 0; counter < CounterCount; ++counter) {
+        if (!hasPerfCounter(delta, (PerfCounter)counter)) continue;
+        uint64_t from = begin.values[counter];
+        uint64_t to = end.values[counter];
+        delta.values[counter] = to > from ? to - from : 0;
+    }
+    return delta;
+}
+
+double perfCounterRatio(const PerfCounterSample& sample, PerfCounter counter, double divisor) {
+    if (!hasPerfCounter(sample, counter) || divisor <= 0.0) return -1.0;
+    return sample.values[counter] / divisor;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "parallel.h"
+#include <cstdint>
+#include <vector>
+
+// Hardware performance counters around the physics kernels, read through
+// Linux perf_event_open. They tell a compute-bound kernel (high IPC, few
+// misses) from a memory-bound one without running the whole program under
+// `perf`.
+//
+// Counters are opened for the calling thread and for every thread of the
+// parallelFor worker pool, and read as their sum, so opening them on the
+// simulation thread also counts the gravity workers. The pool is shared,
+// so a worker's counters only run while it works on a chunk the opening
+// thread started: other jobs on the pool at the same time (the gravity
+// sheet) are not counted. Only user-space events are counted, which is all
+// an unprivileged process may see.
+//
+// Each counter is optional: the kernel may refuse any of them (virtual
+// machines often expose no hardware events, perf_event_paranoid may forbid
+// them) and other platforms have none at all. Missing counters read as
+// unavailable rather than as zero.
+enum PerfCounter {
+    CounterCycles,
+    CounterInstructions,
+    CounterL1Misses,        // L1 data cache read misses
+    CounterLLCMisses,       // Last-level cache misses
+    CounterBranchMisses,
+    CounterCount
+};
+
+extern const char* const perfCounterNames[CounterCount];
+
+// One descriptor per counted thread for each counter, in threadIds order
+// (the opening thread first)
+struct PerfCounters {
+    std::vector<int> fds[CounterCount];
+    std::vector<int> threadIds;
+    ChunkHooks workerHooks = {};    // Switch a worker's counters on for the opener's chunks
+};
+
+// Counter totals at one point, or the change between two points. Totals
+// are scaled up if the kernel had to multiplex the counters.
+struct PerfCounterSample {
+    uint64_t values[CounterCount] = {};
+    unsigned int available = 0;     // Bit per PerfCounter
+};
+
+// Open every counter for the calling thread and the worker pool. Returns
+// false (after saying why) if none could be opened. `counters` must stay
+// in place until closePerfCounters, called on the same thread.
+bool openPerfCounters(PerfCounters& counters);
+void closePerfCounters(PerfCounters& counters);
+
+void readPerfCounters(const PerfCounters& counters, PerfCounterSample& sample);
+
+// Counts between `begin` and `end`, available where both were
+PerfCounterSample perfCounterDelta(const PerfCounterSample& begin, const PerfCounterSample& end);
+
+inline bool hasPerfCounter(const PerfCounterSample& sample, PerfCounter counter) {
+    return (sample.available >> counter) & 1u;
+}
+
+// `counter` divided by `divisor` (another counter's count, or a body or
+// interaction count), or a negative value if the counter is unavailable
+double perfCounterRatio(const PerfCounterSample& sample, PerfCounter counter, double divisor);
@@ -0,0 +1,191 @@
+#include "physics.h"
+#include "parallel.h"
+#include "tracer.h"
+#include <chrono>
+#include <cstdlib>
+
+// Initialize sphere physics
+BodyList spheres = {
+    {
+        glm::vec3(3.0f, 2.0f, 0.0f),    // Starting position
+        glm::vec3(-1.0f, -2.0f, 0.0f),  // Initial velocity  
+        glm::vec3(0.0f, 0.0f, 0.0f),    // Gravity acceleration  
+        1.0f,                           // Mass
+        1.0f,                           // Radius
+        0.8f,                           // Bounce damping factor
+        glm::vec3(1.0f, 0.0f, 0.0f)     // color
+    },
+    {
+        glm::vec3(-3.0f, 2.0f, 0.0f),   // starting position  
+        glm::vec3(1.0f, 0.0f, -1.0f),   // initial velocity  
+        glm::vec3(0.0f, 0.0f, 0.0f),    // Same gravity  
+        1.0f,                           // mass
+        1.0f,                           // Same radius
+        0.9f,                           // Different bounce damping
+        glm::vec3(0.0f, 0.0f, 1.0f)     // color
+    },
+    {
+        glm::vec3(-3.0f, -2.0f, 0.0f),  // starting position  
+        glm::vec3(0.0f, 2.0f, 2.0f),    // initial velocity  
+        glm::vec3(0.0f, 0.0f, 0.0f),    // Same gravity  
+        1.0f,                           // mass
+        1.0f,                           // Same radius
+        0.9f,                           // Different bounce damping
+        glm::vec3(0.0f, 1.0f, 0.0f)     // color
+    }
+};
+
+std::atomic<bool> playback(true);
+
+void handleCollisions(SpherePhysics& sphere, SpherePhysics& sphere1){
+    glm::vec3 change1 = sphere1.position - sphere.position;
+    float distance1 = glm::length(change1);
+    float minDistance1 = sphere.radius + sphere1.radius;
+
+    if (distance1 <= minDistance1 && distance1 > 0.01f) {
+        // Collision normal
+        glm::vec3 normal = change1 / distance1;
+        
+        // Separate spheres more aggressively
+        float overlap = minDistance1 - distance1;
+        float separationAmount = overlap * 0.5f + 0.05f; // Increased separation
+        sphere.position -= normal * separationAmount;
+        sphere1.position += normal * separationAmount;
+        
+        // Simple elastic collision (equal mass)
+        glm::vec3 relativeVelocity = sphere1.velocity - sphere.velocity;
+        float velocityAlongNormal = glm::dot(relativeVelocity, normal);
+        
+        if (velocityAlongNormal > 0) return; // Objects separating
+        
+        // Apply collision response
+        float restitution = 0.8f; // Bounciness factor
+        float impulse = -(1 + restitution) * velocityAlongNormal;
+        
+        sphere.velocity += impulse * normal;
+        sphere1.velocity -= impulse * normal;
+        
+        // Add tiny random component only during collision to break symmetry
+        float randomStrength = 0.1f;
+        glm::vec3 randomVec = glm::vec3(
+            (rand() / (float)RAND_MAX - 0.5f) * randomStrength,
+            (rand() / (float)RAND_MAX - 0.5f) * randomStrength,
+            (rand() / (float)RAND_MAX - 0.5f) * randomStrength
+        );
+        sphere.velocity += randomVec;
+        sphere1.velocity -= randomVec; // Conserve momentum
+    }
+    
+    float maxSpeed = 50.0f;
+    if (glm::length(sphere.velocity) > maxSpeed){
+        sphere.velocity = glm::normalize(sphere.velocity) * maxSpeed;
+    }
+    if (glm::length(sphere1.velocity) > maxSpeed){
+        sphere1.velocity = glm::normalize(sphere1.velocity) * maxSpeed; // Fixed this line
+    }
+}
+
+glm::vec3 computeAcceleration(const SpherePhysics& sphere, const BodyList& bodies) {
+    const float G = gravitationalConstant;
+    glm::vec3 force = glm::vec3(0.0f, 0.0f, 0.0f);
+    
+    for (const SpherePhysics& other : bodies) {
+        if (&other == &sphere) continue;
+        
+        glm::vec3 change = other.position - sphere.position;
+        float distSq = glm::dot(change, change);
+        
+        // Prevent division by zero and extreme forces
+        if (distSq <= 0.01f) continue;
+        
+        // Calculate force direction and magnitude
+        float forceMag = (G * other.mass) / distSq;
+        force += forceMag * glm::normalize(change);
+    }
+    
+    // Apply force as acceleration (F = ma, so a = F/m)
+    return force / sphere.mass;
+}
+
+// Keep your original updatePhysics function - it was working fine
+void updatePhysics(SpherePhysics& sphere, const BodyList& bodies, float deltaTime) {
+    if (!playback) return;
+    
+    sphere.acceleration = computeAcceleration(sphere, bodies);
+    
+    // Update velocity based on acceleration
+    sphere.velocity += sphere.acceleration * deltaTime;
+    
+    // Update position based on velocity
+    sphere.position += sphere.velocity * deltaTime;
+}
+
+void advanceBodies(BodyList& bodies, float deltaTime, StepTimings* timings,
+                   const PerfCounters* counters, unsigned int threadCount) {
+    using Clock = std::chrono::steady_clock;
+    if (!timings) counters = nullptr;
+    PerfCounterSample countersStart, countersGravity;
+    if (counters) readPerfCounters(*counters, countersStart);
+    auto start = Clock::now();
+    
+    // Gravity only reads positions, so each thread can own a range of bodies
+    if (threadCount == 0) threadCount = bodies.size() >= parallelPhysicsThreshold ? hardwareThreadCount() : 1;
+    {
+        TRACE_ZONE("gravity");
+        parallelFor(0, bodies.size(), threadCount, [&](size_t begin, size_t end, unsigned int) {
+            TRACE_ZONE("gravity chunk");
+            for (size_t i = begin; i < end; ++i) {
+                bodies[i].acceleration = computeAcceleration(bodies[i], bodies);
+            }
+        });
+    }
+    auto gravityDone = Clock::now();
+    if (counters) readPerfCounters(*counters, countersGravity);
+    
+    // Integrate once every acceleration is known
+    {
+        TRACE_ZONE("integrate");
+        for (SpherePhysics& body : bodies) {
+            body.velocity += body.acceleration * deltaTime;
+            body.position += body.velocity * deltaTime;
+        }
+    }
+    auto integrateDone = Clock::now();
+    
+    if (timings) {
+        using Milliseconds = std::chrono::duration<double, std::milli>;
+        timings->gravity = Milliseconds(gravityDone - start).count();
+        timings->integrate = Milliseconds(integrateDone - gravityDone).count();
+    }
+    if (counters) timings->gravityCounters = perfCounterDelta(countersStart, countersGravity);
+}
+
+void stepPhysics(BodyList& bodies, float deltaTime, StepTimings* timings,
+                 const PerfCounters* counters, unsigned int threadCount) {
+    TRACE_ZONE("stepPhysics");
+    using Clock = std::chrono::steady_clock;
+    if (!timings) counters = nullptr;
+    advanceBodies(bodies, deltaTime, timings, counters, threadCount);
+    
+    PerfCounterSample countersStart, countersEnd;
+    if (counters) readPerfCounters(*counters, countersStart);
+    auto start = Clock::now();
+    {
+        TRACE_ZONE("collisions");
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            for (size_t j = i + 1; j < bodies.size(); ++j) {
+                handleCollisions(bodies[i], bodies[j]);
+            }
+        }
+    }
+    
+    auto collisionsDone = Clock::now();
+    if (counters) readPerfCounters(*counters, countersEnd);
+    
+    if (timings) {
+        using Milliseconds = std::chrono::duration<double, std::milli>;
+        timings->collisions = Milliseconds(collisionsDone - start).count();
+        timings->bodyCount = bodies.size();
+    }
+    if (counters) timings->collisionCounters = perfCounterDelta(countersStart, countersEnd);
+}
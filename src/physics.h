@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../include/glm/glm.hpp"
+#include "perf_counters.h"
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Physics variables
+struct SpherePhysics {
+    glm::vec3 position;
+    glm::vec3 velocity;
+    glm::vec3 acceleration;
+    float mass;  // Changed from double to float
+    float radius;
+    float bounceDamping;
+    glm::vec3 color;
+    float luminosity = 0.0f;    // Emitted light; bodies above zero light their neighbours
+};
+
+// Allocator whose argument-less construct writes nothing, where
+// std::allocator would value-initialize (and even default initialization
+// would store luminosity), so sizing a list of plain-data elements does not
+// touch every one on one thread before a parallel pass writes them anyway.
+// Copies and moves construct normally.
+template <typename T>
+struct UninitializedAllocator : std::allocator<T> {
+    template <typename U> struct rebind { using other = UninitializedAllocator<U>; };
+    UninitializedAllocator() = default;
+    template <typename U> UninitializedAllocator(const UninitializedAllocator<U>&) {}
+    
+    template <typename U> void construct(U*) {
+        static_assert(std::is_trivially_copyable<U>::value, "Only plain data may be left unwritten");
+    }
+    template <typename U, typename... Args> void construct(U* p, Args&&... args) {
+        ::new ((void*)p) U(std::forward<Args>(args)...);
+    }
+};
+
+// A list of bodies. Sized construction (BodyList(n), resize(n)) leaves the
+// new bodies unwritten, which only the loaders use: they fill in every
+// field from their parallel passes. Everywhere else bodies are built whole.
+using BodyList = std::vector<SpherePhysics, UninitializedAllocator<SpherePhysics>>;
+
+// Gravitational constant used by updatePhysics (and by the scene generators
+// to put bodies in equilibrium)
+const float gravitationalConstant = 15.0f;
+
+// All simulated bodies; the default scene is the original three spheres
+extern BodyList spheres;
+
+// Toggled with the space bar; pauses the simulation (or a replay). Written
+// by the GL thread and read by the simulation thread.
+extern std::atomic<bool> playback;
+
+// Bodies at or above this count have their gravity summed on every hardware thread
+const size_t parallelPhysicsThreshold = 2048;
+
+void handleCollisions(SpherePhysics& sphere, SpherePhysics& sphere1);
+
+// Gravitational acceleration on `sphere` from every other body in `bodies`
+glm::vec3 computeAcceleration(const SpherePhysics& sphere, const BodyList& bodies);
+
+// Accumulate gravity from every other body in `bodies` and integrate `sphere`
+void updatePhysics(SpherePhysics& sphere, const BodyList& bodies, float deltaTime);
+
+// Wall-clock time spent in each part of one stepPhysics call, in milliseconds
+struct StepTimings {
+    double gravity = 0.0;
+    double integrate = 0.0;
+    double collisions = 0.0;
+
+    // Hardware counters over the gravity and collision passes, if the step
+    // was given counters to read
+    PerfCounterSample gravityCounters;
+    PerfCounterSample collisionCounters;
+    size_t bodyCount = 0;
+};
+
+// Body pairs each pass visits for `bodyCount` bodies: gravity sums every
+// other body for each body, collisions test each unordered pair once
+inline double gravityInteractions(size_t bodyCount) {
+    return (double)bodyCount * (bodyCount > 0 ? bodyCount - 1 : 0);
+}
+inline double collisionInteractions(size_t bodyCount) {
+    return gravityInteractions(bodyCount) * 0.5;
+}
+
+// The gravity and integration passes of stepPhysics, without the
+// collision pass or the pause check, for harnesses that need exactly the
+// production integrator. Fills in the gravity and integrate parts of
+// `timings`; the other arguments work as in stepPhysics.
+void advanceBodies(BodyList& bodies, float deltaTime, StepTimings* timings = nullptr,
+                   const PerfCounters* counters = nullptr, unsigned int threadCount = 0);
+
+// Advance every body by one step, then resolve pairwise collisions. All
+// accelerations are computed from the positions at the start of the step,
+// so the force pass can be split across threads. `timings` is optional;
+// `counters` (opened on the calling thread) fills in its counter samples.
+// `threadCount` 0 uses every hardware thread from parallelPhysicsThreshold
+// bodies up and one below it; any other value is used as given. Always
+// steps: pausing (playback) is up to the caller.
+void stepPhysics(BodyList& bodies, float deltaTime, StepTimings* timings = nullptr,
+                 const PerfCounters* counters = nullptr, unsigned int threadCount = 0);
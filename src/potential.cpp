@@ -0,0 +1,385 @@
+#include "potential.h"
+#include "parallel.h"
+#include "tracer.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define POTENTIAL_SSE 1
+#endif
+
+// Bodies per leaf, and a depth cap so coincident bodies cannot recurse forever
+const uint32_t potentialLeafSize = 16;
+const int potentialMaxDepth = 24;
+
+// Samples per tile side; every sample in a tile shares one interaction list
+const int potentialTileSize = 16;
+
+// Trees over this many bodies build the root's eight subtrees in parallel
+const size_t potentialParallelBuildThreshold = 16384;
+
+static PotentialTreeNode makeNode(const uint32_t* order, const RenderBodies& bodies, uint32_t begin, uint32_t end,
+                                  float centerX, float centerY, float centerZ, float halfSize) {
+    PotentialTreeNode node;
+    node.centerX = centerX;
+    node.centerY = centerY;
+    node.centerZ = centerZ;
+    node.halfSize = halfSize;
+    node.bodyBegin = begin;
+    node.bodyEnd = end;
+    std::fill(node.children, node.children + 8, -1);
+
+    double mass = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+    for (uint32_t k = begin; k < end; ++k) {
+        uint32_t i = order[k];
+        double m = bodies.mass[i];
+        mass += m;
+        mx += m * bodies.x[i];
+        my += m * bodies.y[i];
+        mz += m * bodies.z[i];
+    }
+    node.mass = (float)mass;
+    if (mass > 0.0) {
+        node.comX = (float)(mx / mass);
+        node.comY = (float)(my / mass);
+        node.comZ = (float)(mz / mass);
+    } else {
+        node.comX = centerX;
+        node.comY = centerY;
+        node.comZ = centerZ;
+    }
+    return node;
+}
+
+static bool isLeaf(uint32_t begin, uint32_t end, int depth) {
+    return end - begin <= potentialLeafSize || depth >= potentialMaxDepth ||
+           (depth == 0 && end - begin <= potentialDirectSumThreshold);
+}
+
+// Split order[begin, end) into octants around the center: by x, then each
+// half by y, then each quarter by z. Octant k is [bounds[k], bounds[k + 1]).
+static void splitOctants(uint32_t* order, const RenderBodies& bodies, uint32_t begin, uint32_t end,
+                         float centerX, float centerY, float centerZ, uint32_t bounds[9]) {
+    uint32_t* first = order + begin;
+    uint32_t* last = order + end;
+    uint32_t* splitX = std::partition(first, last, [&](uint32_t i) { return bodies.x[i] < centerX; });
+    uint32_t* split[9];
+    split[0] = first;
+    split[8] = last;
+    split[4] = splitX;
+    split[2] = std::partition(first, splitX, [&](uint32_t i) { return bodies.y[i] < centerY; });
+    split[6] = std::partition(splitX, last, [&](uint32_t i) { return bodies.y[i] < centerY; });
+    for (int q = 0; q < 4; ++q) {
+        split[q * 2 + 1] = std::partition(split[q * 2], split[q * 2 + 2], [&](uint32_t i) { return bodies.z[i] < centerZ; });
+    }
+    for (int k = 0; k < 9; ++k) bounds[k] = (uint32_t)(split[k] - order);
+}
+
+static int32_t buildNode(std::vector<PotentialTreeNode>& nodes, uint32_t* order, const RenderBodies& bodies,
+                         uint32_t begin, uint32_t end, float centerX, float centerY, float centerZ,
+                         float halfSize, int depth) {
+    int32_t index = (int32_t)nodes.size();
+    nodes.push_back(makeNode(order, bodies, begin, end, centerX, centerY, centerZ, halfSize));
+    if (isLeaf(begin, end, depth)) return index;
+
+    uint32_t bounds[9];
+    splitOctants(order, bodies, begin, end, centerX, centerY, centerZ, bounds);
+
+    float quarter = halfSize * 0.5f;
+    for (int octant = 0; octant < 8; ++octant) {
+        if (bounds[octant] == bounds[octant + 1]) continue;
+        float childX = centerX + ((octant & 4) ? quarter : -quarter);
+        float childY = centerY + ((octant & 2) ? quarter : -quarter);
+        float childZ = centerZ + ((octant & 1) ? quarter : -quarter);
+        int32_t child = buildNode(nodes, order, bodies, bounds[octant], bounds[octant + 1],
+                                  childX, childY, childZ, quarter, depth + 1);
+        nodes[index].children[octant] = child;
+    }
+    return index;
+}
+
+void buildPotentialTree(const RenderBodies& bodies, PotentialTree& tree) {
+    size_t count = bodies.size();
+    tree.nodes.clear();
+    tree.order.resize(count);
+    std::iota(tree.order.begin(), tree.order.end(), 0u);
+    if (count == 0) {
+        tree.x.clear();
+        tree.y.clear();
+        tree.z.clear();
+        tree.mass.clear();
+        return;
+    }
+
+    float minX = bodies.x[0], maxX = minX;
+    float minY = bodies.y[0], maxY = minY;
+    float minZ = bodies.z[0], maxZ = minZ;
+    for (size_t i = 1; i < count; ++i) {
+        minX = std::min(minX, bodies.x[i]);
+        maxX = std::max(maxX, bodies.x[i]);
+        minY = std::min(minY, bodies.y[i]);
+        maxY = std::max(maxY, bodies.y[i]);
+        minZ = std::min(minZ, bodies.z[i]);
+        maxZ = std::max(maxZ, bodies.z[i]);
+    }
+    float halfSize = 0.5f * std::max(std::max(maxX - minX, maxY - minY), maxZ - minZ) + 1e-3f;
+    float centerX = 0.5f * (minX + maxX), centerY = 0.5f * (minY + maxY), centerZ = 0.5f * (minZ + maxZ);
+
+    tree.nodes.reserve(count / potentialLeafSize * 2 + 1);
+    if (count < potentialParallelBuildThreshold) {
+        buildNode(tree.nodes, tree.order.data(), bodies, 0, (uint32_t)count, centerX, centerY, centerZ, halfSize, 0);
+    } else {
+        // Each of the root's octants builds its own node list on a worker,
+        // then the lists are appended after the root with their child
+        // indices shifted
+        tree.nodes.push_back(makeNode(tree.order.data(), bodies, 0, (uint32_t)count, centerX, centerY, centerZ, halfSize));
+        uint32_t bounds[9];
+        splitOctants(tree.order.data(), bodies, 0, (uint32_t)count, centerX, centerY, centerZ, bounds);
+
+        std::vector<PotentialTreeNode> subtrees[8];
+        float quarter = halfSize * 0.5f;
+        parallelFor(0, 8, 8, [&](size_t octantBegin, size_t octantEnd, unsigned int) {
+            for (size_t octant = octantBegin; octant < octantEnd; ++octant) {
+                if (bounds[octant] == bounds[octant + 1]) continue;
+                subtrees[octant].reserve((bounds[octant + 1] - bounds[octant]) / potentialLeafSize * 2 + 1);
+                buildNode(subtrees[octant], tree.order.data(), bodies, bounds[octant], bounds[octant + 1],
+                          centerX + ((octant & 4) ? quarter : -quarter),
+                          centerY + ((octant & 2) ? quarter : -quarter),
+                          centerZ + ((octant & 1) ? quarter : -quarter), quarter, 1);
+            }
+        });
+
+        for (int octant = 0; octant < 8; ++octant) {
+            if (subtrees[octant].empty()) continue;
+            int32_t offset = (int32_t)tree.nodes.size();
+            tree.nodes[0].children[octant] = offset;
+            for (PotentialTreeNode& node : subtrees[octant]) {
+                for (int32_t& child : node.children) {
+                    if (child >= 0) child += offset;
+                }
+                tree.nodes.push_back(node);
+            }
+        }
+    }
+
+    // Leaf bodies contiguous in tree order, so lists copy whole ranges
+    tree.x.resize(count);
+    tree.y.resize(count);
+    tree.z.resize(count);
+    tree.mass.resize(count);
+    parallelFor(0, count, hardwareThreadCount(), [&](size_t begin, size_t end, unsigned int) {
+        for (size_t k = begin; k < end; ++k) {
+            uint32_t i = tree.order[k];
+            tree.x[k] = bodies.x[i];
+            tree.y[k] = bodies.y[i];
+            tree.z[k] = bodies.z[i];
+            tree.mass[k] = bodies.mass[i];
+        }
+    });
+}
+
+// Point masses one tile has to sum
+struct InteractionList {
+    std::vector<float> x, y, z, mass;
+
+    void clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+        mass.clear();
+    }
+    void add(float px, float py, float pz, float m) {
+        x.push_back(px);
+        y.push_back(py);
+        z.push_back(pz);
+        mass.push_back(m);
+    }
+};
+
+// Collect what the tile [minX, maxX] x [minZ, maxZ] (at y = 0) interacts
+// with. A node is used as a point mass when its size is small against its
+// distance from the nearest point of the tile.
+static void gatherInteractions(const PotentialTree& tree, float theta, float minX, float maxX,
+                               float minZ, float maxZ, InteractionList& list, std::vector<int32_t>& stack) {
+    float thetaSq = theta * theta;
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const PotentialTreeNode& node = tree.nodes[stack.back()];
+        stack.pop_back();
+
+        float dx = std::max(std::max(minX - node.comX, node.comX - maxX), 0.0f);
+        float dz = std::max(std::max(minZ - node.comZ, node.comZ - maxZ), 0.0f);
+        float distSq = dx * dx + node.comY * node.comY + dz * dz;
+        float size = 2.0f * node.halfSize;
+        if (size * size < thetaSq * distSq) {
+            list.add(node.comX, node.comY, node.comZ, node.mass);
+            continue;
+        }
+
+        bool leaf = true;
+        for (int32_t child : node.children) {
+            if (child < 0) continue;
+            stack.push_back(child);
+            leaf = false;
+        }
+        if (leaf) {
+            for (uint32_t k = node.bodyBegin; k < node.bodyEnd; ++k) {
+                list.add(tree.x[k], tree.y[k], tree.z[k], tree.mass[k]);
+            }
+        }
+    }
+}
+
+// Sum the list for `count` samples along one row: x = firstX + c * spacing
+static void evaluateRow(const InteractionList& list, float firstX, float spacing, float sampleZ,
+                        float softeningSq, int count, float* out) {
+    size_t sources = list.x.size();
+    const float* sx = list.x.data();
+    const float* sy = list.y.data();
+    const float* sz = list.z.data();
+    const float* sm = list.mass.data();
+    int c = 0;
+
+#if defined(__AVX__)
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    for (; c + 8 <= count; c += 8) {
+        __m256 px = _mm256_add_ps(_mm256_set1_ps(firstX + c * spacing),
+                                  _mm256_mul_ps(_mm256_set1_ps(spacing), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)));
+        __m256 sum = _mm256_setzero_ps();
+        for (size_t k = 0; k < sources; ++k) {
+            float dz = sz[k] - sampleZ;
+            __m256 base = _mm256_set1_ps(sy[k] * sy[k] + dz * dz + softeningSq);
+            __m256 dx = _mm256_sub_ps(_mm256_set1_ps(sx[k]), px);
+            __m256 distSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), base);
+            // rsqrt estimate refined by one Newton step
+            __m256 inv = _mm256_rsqrt_ps(distSq);
+            inv = _mm256_mul_ps(inv, _mm256_sub_ps(threeHalves, _mm256_mul_ps(_mm256_mul_ps(half, distSq), _mm256_mul_ps(inv, inv))));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(sm[k]), inv));
+        }
+        _mm256_storeu_ps(out + c, _mm256_sub_ps(_mm256_setzero_ps(), sum));
+    }
+#elif defined(POTENTIAL_SSE)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    for (; c + 4 <= count; c += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps(firstX + c * spacing),
+                               _mm_mul_ps(_mm_set1_ps(spacing), _mm_setr_ps(0, 1, 2, 3)));
+        __m128 sum = _mm_setzero_ps();
+        for (size_t k = 0; k < sources; ++k) {
+            float dz = sz[k] - sampleZ;
+            __m128 base = _mm_set1_ps(sy[k] * sy[k] + dz * dz + softeningSq);
+            __m128 dx = _mm_sub_ps(_mm_set1_ps(sx[k]), px);
+            __m128 distSq = _mm_add_ps(_mm_mul_ps(dx, dx), base);
+            // rsqrt estimate refined by one Newton step
+            __m128 inv = _mm_rsqrt_ps(distSq);
+            inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, distSq), _mm_mul_ps(inv, inv))));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(sm[k]), inv));
+        }
+        _mm_storeu_ps(out + c, _mm_sub_ps(_mm_setzero_ps(), sum));
+    }
+#endif
+
+    for (; c < count; ++c) {
+        float px = firstX + c * spacing;
+        float sum = 0.0f;
+        for (size_t k = 0; k < sources; ++k) {
+            float dx = sx[k] - px;
+            float dz = sz[k] - sampleZ;
+            sum += sm[k] / std::sqrt(dx * dx + sy[k] * sy[k] + dz * dz + softeningSq);
+        }
+        out[c] = -sum;
+    }
+}
+
+void evaluatePotentialSheet(const PotentialTree& tree, const PotentialSheet& sheet,
+                            std::vector<float>& potential, unsigned int threadCount) {
+    int resolution = sheet.resolution;
+    potential.assign((size_t)resolution * resolution, 0.0f);
+    if (tree.nodes.empty()) return;
+
+    int tilesPerSide = (resolution + potentialTileSize - 1) / potentialTileSize;
+    float softeningSq = sheet.softening * sheet.softening;
+
+    parallelFor(0, (size_t)tilesPerSide, threadCount, [&](size_t tileRowBegin, size_t tileRowEnd, unsigned int) {
+        InteractionList list;
+        std::vector<int32_t> stack;
+        for (size_t tileRow = tileRowBegin; tileRow < tileRowEnd; ++tileRow) {
+            int row0 = (int)tileRow * potentialTileSize;
+            int row1 = std::min(row0 + potentialTileSize, resolution);
+            for (int tileCol = 0; tileCol < tilesPerSide; ++tileCol) {
+                int col0 = tileCol * potentialTileSize;
+                int col1 = std::min(col0 + potentialTileSize, resolution);
+
+                list.clear();
+                gatherInteractions(tree, sheet.theta,
+                                   sheet.origin + col0 * sheet.spacing, sheet.origin + (col1 - 1) * sheet.spacing,
+                                   sheet.origin + row0 * sheet.spacing, sheet.origin + (row1 - 1) * sheet.spacing,
+                                   list, stack);
+
+                for (int row = row0; row < row1; ++row) {
+                    evaluateRow(list, sheet.origin + col0 * sheet.spacing, sheet.spacing,
+                                sheet.origin + row * sheet.spacing, softeningSq, col1 - col0,
+                                potential.data() + (size_t)row * resolution + col0);
+                }
+            }
+        }
+    });
+}
+
+static void runPotentialWorker(PotentialWorker& worker) {
+    TRACE_THREAD_NAME("potential");
+    RenderBodies bodies;
+    PotentialTree tree;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.wake.wait(lock, [&] { return worker.requested || !worker.running; });
+            if (!worker.running) return;
+            std::swap(bodies.x, worker.input.x);
+            std::swap(bodies.y, worker.input.y);
+            std::swap(bodies.z, worker.input.z);
+            std::swap(bodies.mass, worker.input.mass);
+            worker.requested = false;
+        }
+
+        TRACE_ZONE("potentialSheet");
+        buildPotentialTree(bodies, tree);
+        evaluatePotentialSheet(tree, worker.sheet, snapshotWriteSlot(worker.sheets), hardwareThreadCount());
+        publishSnapshot(worker.sheets);
+    }
+}
+
+void startPotentialWorker(PotentialWorker& worker, const PotentialSheet& sheet) {
+    worker.sheet = sheet;
+    worker.running = true;
+    worker.thread = std::thread(runPotentialWorker, std::ref(worker));
+}
+
+void stopPotentialWorker(PotentialWorker& worker) {
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.running = false;
+    }
+    worker.wake.notify_one();
+    if (worker.thread.joinable()) worker.thread.join();
+}
+
+void requestPotentialSheet(PotentialWorker& worker, const RenderBodies& bodies) {
+    TRACE_ZONE("requestPotentialSheet");
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.input.x.assign(bodies.x.begin(), bodies.x.end());
+        worker.input.y.assign(bodies.y.begin(), bodies.y.end());
+        worker.input.z.assign(bodies.z.begin(), bodies.z.end());
+        worker.input.mass.assign(bodies.mass.begin(), bodies.mass.end());
+        worker.requested = true;
+    }
+    worker.wake.notify_one();
+}
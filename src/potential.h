@@ -0,0 +1,75 @@
+#pragma once
+
+#include "render_bodies.h"
+#include "triple_buffer.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Gravitational potential sampled on a square grid in the y = 0 plane,
+// used to sink the reference grid into "gravity wells".
+//
+// Bodies go into an octree. Samples are evaluated in tiles: each tile walks
+// the tree once and collects an interaction list (far nodes as point masses
+// at their centers of mass, near leaves as individual bodies). The list is
+// then summed for every sample in the tile, several samples at a time with
+// SIMD. Small scenes keep all bodies in a single root leaf, so every tile
+// near them sums the bodies directly.
+struct PotentialTreeNode {
+    float comX, comY, comZ, mass;               // Center of mass and total mass
+    float centerX, centerY, centerZ, halfSize;  // Cubic cell bounds
+    uint32_t bodyBegin, bodyEnd;                // Leaf bodies, in tree order
+    int32_t children[8];                        // -1 where empty; all -1 for leaves
+};
+
+struct PotentialTree {
+    std::vector<PotentialTreeNode> nodes;       // nodes[0] is the root
+    std::vector<float> x, y, z, mass;           // Bodies sorted into leaf order
+    std::vector<uint32_t> order;
+};
+
+struct PotentialSheet {
+    int resolution = 512;       // Samples per side
+    float origin = -60.0f;      // x and z of the first sample
+    float spacing = 120.0f / 511.0f;
+    float softening = 0.5f;     // Plummer softening length
+    float theta = 0.8f;         // Opening angle; 0 evaluates every body directly
+};
+
+// Scenes up to this size are summed directly (the root is one leaf)
+const size_t potentialDirectSumThreshold = 512;
+
+// Large trees build the root's subtrees on every hardware thread
+void buildPotentialTree(const RenderBodies& bodies, PotentialTree& tree);
+
+// Fill `potential` (resolution * resolution, row-major with rows along z)
+// with -sum(m / sqrt(r^2 + softening^2)) over every body; multiply by the
+// gravitational constant for physical units. Rows of tiles are split over
+// `threadCount` threads.
+void evaluatePotentialSheet(const PotentialTree& tree, const PotentialSheet& sheet,
+                            std::vector<float>& potential, unsigned int threadCount);
+
+// Builds trees and evaluates sheets on its own thread, so the GL thread
+// never waits for either: it hands over bodies with requestPotentialSheet
+// and picks up finished sheets from `sheets` with consumeSnapshot. Requests
+// made while a sheet is being evaluated replace each other; only the newest
+// is evaluated next.
+struct PotentialWorker {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running = false;
+    bool requested = false;         // `input` holds bodies not evaluated yet
+    RenderBodies input;             // Positions and masses only
+    PotentialSheet sheet;
+
+    TripleBuffer<std::vector<float>> sheets;
+};
+
+void startPotentialWorker(PotentialWorker& worker, const PotentialSheet& sheet);
+void stopPotentialWorker(PotentialWorker& worker);
+
+// Copy the bodies' positions and masses for the worker's next sheet
+void requestPotentialSheet(PotentialWorker& worker, const RenderBodies& bodies);
@@ -0,0 +1,67 @@
+#include "profiler.h"
+#include <algorithm>
+
+const char* const profilePhaseNames[PhaseCount] = {
+    "frame", "sync", "lights", "cull", "submit", "flush", "swap",
+    "sim gravity", "sim integrate", "sim collisions",
+    "gpu spheres", "gpu trails", "gpu grid"};
+
+void recordPhase(Profiler& profiler, ProfilePhase phase, double milliseconds) {
+    PhaseTimes& times = profiler.phases[phase];
+    times.samples[times.next] = (float)milliseconds;
+    times.next = (times.next + 1) % profileWindow;
+    times.count = std::min(times.count + 1, profileWindow);
+}
+
+float phaseAverage(const PhaseTimes& times) {
+    if (times.count == 0) return 0.0f;
+    double sum = 0.0;
+    for (int i = 0; i < times.count; ++i) sum += times.samples[i];
+    return (float)(sum / times.count);
+}
+
+float phasePercentile(const PhaseTimes& times, float fraction) {
+    if (times.count == 0) return 0.0f;
+    float sorted[profileWindow];
+    std::copy(times.samples, times.samples + times.count, sorted);
+    int rank = std::min(times.count - 1, (int)(fraction * times.count));
+    std::nth_element(sorted, sorted + rank, sorted + times.count);
+    return sorted[rank];
+}
+
+void createGpuTimers(GpuTimers& timers) {
+    glGenQueries(2 * GpuPassCount, &timers.queries[0][0]);
+}
+
+void destroyGpuTimers(GpuTimers& timers) {
+    if (timers.activePass >= 0) glEndQuery(GL_TIME_ELAPSED);
+    glDeleteQueries(2 * GpuPassCount, &timers.queries[0][0]);
+    timers = GpuTimers();
+}
+
+void beginGpuFrame(GpuTimers& timers, Profiler& profiler) {
+    switchGpuPass(timers, -1);
+    timers.slot ^= 1;
+    for (int pass = 0; pass < GpuPassCount; ++pass) {
+        if (!timers.issued[timers.slot][pass]) continue;
+        timers.issued[timers.slot][pass] = false;
+
+        // Not ready after two frames means the GPU is far behind; drop the sample
+        unsigned int query = timers.queries[timers.slot][pass];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        recordPhase(profiler, (ProfilePhase)(PhaseGpuSpheres + pass), nanoseconds * 1e-6);
+    }
+}
+
+void switchGpuPass(GpuTimers& timers, int pass) {
+    if (pass == timers.activePass) return;
+    if (timers.activePass >= 0) glEndQuery(GL_TIME_ELAPSED);
+    timers.activePass = pass;
+    if (pass < 0) return;
+    glBeginQuery(GL_TIME_ELAPSED, timers.queries[timers.slot][pass]);
+    timers.issued[timers.slot][pass] = true;
+}
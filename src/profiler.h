@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../include/glad/glad.h"
+#include <chrono>
+#include <cstdint>
+
+// Frame phases timed for the performance overlay. CPU phases are measured
+// on the GL thread, simulation phases on the simulation thread (one sample
+// per step, handed over through the simulation's step ring) and GPU phases with
+// GL_TIME_ELAPSED queries.
+enum ProfilePhase {
+    PhaseFrame,             // Whole frame, start to start
+    PhaseSync,              // Taking the newest snapshot or replay frame
+    PhaseLights,            // Light cluster binning and upload
+    PhaseCull,
+    PhaseSubmit,            // Instance writes and draw submission
+    PhaseFlush,             // Issuing the render queue
+    PhaseSwap,              // Buffer swap and event polling
+    PhaseSimGravity,
+    PhaseSimIntegrate,
+    PhaseSimCollisions,
+    PhaseGpuSpheres,
+    PhaseGpuTrails,
+    PhaseGpuGrid,
+    PhaseCount
+};
+
+extern const char* const profilePhaseNames[PhaseCount];
+
+// Samples kept per phase; about four seconds at 60 fps (simulation phases,
+// sampled once per step, cover less)
+const int profileWindow = 240;
+
+// Rolling window of one phase's most recent durations, in milliseconds
+struct PhaseTimes {
+    float samples[profileWindow];
+    int count = 0;
+    int next = 0;
+};
+
+struct Profiler {
+    PhaseTimes phases[PhaseCount];
+};
+
+void recordPhase(Profiler& profiler, ProfilePhase phase, double milliseconds);
+float phaseAverage(const PhaseTimes& times);
+
+// `fraction` in [0, 1], e.g. 0.99 for p99
+float phasePercentile(const PhaseTimes& times, float fraction);
+
+// Records the time from construction to destruction into one phase
+struct ScopedPhaseTimer {
+    Profiler& profiler;
+    ProfilePhase phase;
+    std::chrono::steady_clock::time_point start;
+
+    ScopedPhaseTimer(Profiler& profiler, ProfilePhase phase)
+        : profiler(profiler), phase(phase), start(std::chrono::steady_clock::now()) {}
+    ~ScopedPhaseTimer() {
+        recordPhase(profiler, phase, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+};
+
+// GPU passes, each timed by one GL_TIME_ELAPSED query per frame. Queries
+// are double-buffered: a pass's query from two frames back is read (if the
+// GPU has finished it) before the query object is reused, so reading
+// results never waits on the GPU. Time-elapsed queries cannot nest, so at
+// most one pass is open at a time.
+enum GpuPass {
+    GpuPassSpheres,
+    GpuPassTrails,
+    GpuPassGrid,
+    GpuPassCount
+};
+
+struct GpuTimers {
+    unsigned int queries[2][GpuPassCount] = {};
+    bool issued[2][GpuPassCount] = {};
+    int slot = 0;
+    int activePass = -1;
+};
+
+void createGpuTimers(GpuTimers& timers);
+void destroyGpuTimers(GpuTimers& timers);
+
+// Collect finished results from the slot about to be reused, then switch to it
+void beginGpuFrame(GpuTimers& timers, Profiler& profiler);
+
+// Close the open pass (if any) and open `pass` (if not negative)
+void switchGpuPass(GpuTimers& timers, int pass);
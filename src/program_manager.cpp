@@ -0,0 +1,331 @@
+#include "program_manager.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// Cached binary file: header followed by `length` bytes of driver binary
+struct ProgramBinaryHeader {
+    char magic[8];      // "PSIMPRG1"
+    uint32_t format;
+    uint32_t length;
+};
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string cachePath(const ProgramManager& manager, const ManagedProgram& managed) {
+    // The terminating zeros keep ("ab", "c") and ("a", "bc") apart
+    uint64_t hash = fnv1a(managed.vertexSource.c_str(), managed.vertexSource.size() + 1);
+    hash = fnv1a(managed.fragmentSource.c_str(), managed.fragmentSource.size() + 1, hash);
+    hash = fnv1a(manager.driverString.c_str(), manager.driverString.size(), hash);
+
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return manager.cacheDir + "/" + managed.name + "-" + hex + ".bin";
+}
+
+static bool loadProgramBinary(const std::string& path, unsigned int program) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    ProgramBinaryHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    if (std::memcmp(header.magic, "PSIMPRG1", 8) != 0) return false;
+
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size())) return false;
+
+    glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+    int linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked != 0;
+}
+
+static void saveProgramBinary(const std::string& path, unsigned int program) {
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    ProgramBinaryHeader header;
+    std::memcpy(header.magic, "PSIMPRG1", 8);
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, binary.data());
+    header.format = format;
+    header.length = (uint32_t)length;
+
+    // Written under a temporary name so a crash never leaves a torn cache entry
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        if (!file) return;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), binary.size());
+        if (!file) return;
+    }
+    std::error_code error;
+    fs::rename(temporary, path, error);
+}
+
+static int64_t fileStamp(const std::string& path) {
+    std::error_code error;
+    auto time = fs::last_write_time(path, error);
+    return error ? 0 : (int64_t)time.time_since_epoch().count();
+}
+
+static bool readTextFile(const std::string& path, std::string& text) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    text = contents.str();
+    return true;
+}
+
+// Insert the program's preludes for one stage after the source's #version
+// line (GLSL allows nothing but comments and whitespace before it)
+static void insertPreludes(const ProgramManager& manager, const ManagedProgram& managed, bool fragmentStage,
+                           std::string& source) {
+    std::string shared;
+    for (size_t i = 0; i < manager.preludes.size(); ++i) {
+        const ShaderPrelude& prelude = manager.preludes[i];
+        if (!((managed.preludes >> i) & 1u)) continue;
+        if (fragmentStage ? !prelude.fragmentStage : !prelude.vertexStage) continue;
+        shared += prelude.source;
+    }
+    if (shared.empty()) return;
+
+    size_t version = source.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+    if (lineEnd == std::string::npos) {
+        std::cerr << "WARNING: Shader " << managed.name << " has no #version line, preludes left out" << std::endl;
+        return;
+    }
+    source.insert(lineEnd + 1, shared);
+}
+
+// Fill in the sources: from the shader directory (seeding missing files
+// with the built-in sources) or straight from the built-in sources, then
+// add the preludes
+static void loadSources(const ProgramManager& manager, ManagedProgram& managed) {
+    if (managed.vertexPath.empty()) {
+        managed.vertexSource = managed.builtinVertex;
+        managed.fragmentSource = managed.builtinFragment;
+    } else {
+        const char* builtins[2] = {managed.builtinVertex, managed.builtinFragment};
+        const std::string* paths[2] = {&managed.vertexPath, &managed.fragmentPath};
+        std::string* sources[2] = {&managed.vertexSource, &managed.fragmentSource};
+        for (int i = 0; i < 2; ++i) {
+            if (!fs::exists(*paths[i])) {
+                std::ofstream(*paths[i], std::ios::binary) << builtins[i];
+            }
+            if (!readTextFile(*paths[i], *sources[i])) {
+                std::cerr << "ERROR: Could not read shader " << *paths[i] << std::endl;
+                *sources[i] = builtins[i];
+            }
+        }
+        managed.vertexStamp = fileStamp(managed.vertexPath);
+        managed.fragmentStamp = fileStamp(managed.fragmentPath);
+    }
+    insertPreludes(manager, managed, false, managed.vertexSource);
+    insertPreludes(manager, managed, true, managed.fragmentSource);
+}
+
+void initProgramManager(ProgramManager& manager, const char* cacheDir, const char* shaderDir) {
+    manager.cacheDir = cacheDir;
+    manager.shaderDir = shaderDir ? shaderDir : "";
+
+    const char* vendor = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+    manager.driverString = std::string(vendor ? vendor : "") + "|" + (renderer ? renderer : "") + "|" + (version ? version : "");
+
+    int binaryFormats = 0;
+    if (GLAD_GL_ARB_get_program_binary || GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1)) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    }
+    manager.binaryCache = binaryFormats > 0;
+    if (manager.binaryCache) {
+        std::error_code error;
+        fs::create_directories(manager.cacheDir, error);
+        if (error) manager.binaryCache = false;
+    }
+
+    // Let the driver use as many compiler threads as it likes
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        manager.parallelCompile = true;
+    } else if (GLAD_GL_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+        manager.parallelCompile = true;
+    }
+
+    if (!manager.shaderDir.empty()) {
+        std::error_code error;
+        fs::create_directories(manager.shaderDir, error);
+    }
+}
+
+unsigned int addShaderPrelude(ProgramManager& manager, std::string source, bool vertexStage, bool fragmentStage) {
+    ShaderPrelude prelude;
+    prelude.source = std::move(source);
+    prelude.vertexStage = vertexStage;
+    prelude.fragmentStage = fragmentStage;
+    manager.preludes.push_back(std::move(prelude));
+    return 1u << (manager.preludes.size() - 1);
+}
+
+void addProgram(ProgramManager& manager, ShaderProgram& program, const char* name,
+                const char* vertexSource, const char* fragmentSource, unsigned int preludes,
+                std::function<void(ShaderProgram&)> setup) {
+    ManagedProgram managed;
+    managed.program = &program;
+    managed.name = name;
+    managed.builtinVertex = vertexSource;
+    managed.builtinFragment = fragmentSource;
+    managed.preludes = preludes;
+    managed.setup = std::move(setup);
+    if (!manager.shaderDir.empty()) {
+        managed.vertexPath = manager.shaderDir + "/" + name + ".vert";
+        managed.fragmentPath = manager.shaderDir + "/" + name + ".frag";
+    }
+    manager.programs.push_back(std::move(managed));
+}
+
+// Link the given programs: cached binaries first, then every remaining
+// compile issued, then every link, and only then any status queries, so a
+// parallel-compiling driver has all of them in flight at once
+static bool buildProgramSet(ProgramManager& manager, const std::vector<size_t>& indices) {
+    struct Build {
+        ManagedProgram* managed;
+        unsigned int program = 0;
+        unsigned int vertexShader = 0, fragmentShader = 0;
+        std::string cacheFile;
+        bool cached = false;
+    };
+    std::vector<Build> builds;
+    for (size_t index : indices) {
+        Build build;
+        build.managed = &manager.programs[index];
+        build.program = glCreateProgram();
+        if (manager.binaryCache) {
+            build.cacheFile = cachePath(manager, *build.managed);
+            build.cached = loadProgramBinary(build.cacheFile, build.program);
+        }
+        builds.push_back(build);
+    }
+
+    for (Build& build : builds) {
+        if (build.cached) continue;
+        const char* vertexSource = build.managed->vertexSource.c_str();
+        const char* fragmentSource = build.managed->fragmentSource.c_str();
+        build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(build.vertexShader, 1, &vertexSource, NULL);
+        glCompileShader(build.vertexShader);
+        build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(build.fragmentShader, 1, &fragmentSource, NULL);
+        glCompileShader(build.fragmentShader);
+    }
+
+    for (Build& build : builds) {
+        if (build.cached) continue;
+        glAttachShader(build.program, build.vertexShader);
+        glAttachShader(build.program, build.fragmentShader);
+        if (manager.binaryCache) glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(build.program);
+    }
+
+    bool allLinked = true;
+    for (Build& build : builds) {
+        ManagedProgram& managed = *build.managed;
+        bool linked = build.cached;
+        if (!build.cached) {
+            std::string vertexType = managed.name + " vertex";
+            std::string fragmentType = managed.name + " fragment";
+            checkShaderCompilation(build.vertexShader, vertexType.c_str());
+            checkShaderCompilation(build.fragmentShader, fragmentType.c_str());
+            checkProgramLinking(build.program);
+            glDeleteShader(build.vertexShader);
+            glDeleteShader(build.fragmentShader);
+
+            int status = 0;
+            glGetProgramiv(build.program, GL_LINK_STATUS, &status);
+            linked = status != 0;
+            if (linked && manager.binaryCache) saveProgramBinary(build.cacheFile, build.program);
+        }
+
+        if (!linked) {
+            std::cerr << "ERROR: Program " << managed.name << " failed to build" << std::endl;
+            glDeleteProgram(build.program);
+            allLinked = false;
+            continue;
+        }
+
+        // Swap in the new program; the old one (on reload) is no longer needed
+        ShaderProgram& program = *managed.program;
+        if (program.id) glDeleteProgram(program.id);
+        program.id = build.program;
+        resolveProgramInterface(program);
+        if (managed.setup) {
+            glUseProgram(program.id);
+            managed.setup(program);
+        }
+    }
+    glUseProgram(0);
+    return allLinked;
+}
+
+bool buildPrograms(ProgramManager& manager) {
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < manager.programs.size(); ++i) {
+        loadSources(manager, manager.programs[i]);
+        indices.push_back(i);
+    }
+    return buildProgramSet(manager, indices);
+}
+
+bool reloadChangedPrograms(ProgramManager& manager, double time) {
+    if (manager.shaderDir.empty() || time - manager.lastReloadCheck < shaderReloadInterval) return false;
+    manager.lastReloadCheck = time;
+
+    std::vector<size_t> changed;
+    for (size_t i = 0; i < manager.programs.size(); ++i) {
+        ManagedProgram& managed = manager.programs[i];
+        if (fileStamp(managed.vertexPath) == managed.vertexStamp &&
+            fileStamp(managed.fragmentPath) == managed.fragmentStamp) continue;
+        loadSources(manager, managed);
+        changed.push_back(i);
+    }
+    if (changed.empty()) return false;
+
+    std::vector<unsigned int> previousIds;
+    for (size_t index : changed) previousIds.push_back(manager.programs[index].program->id);
+    buildProgramSet(manager, changed);
+    
+    for (size_t k = 0; k < changed.size(); ++k) {
+        const ManagedProgram& managed = manager.programs[changed[k]];
+        if (managed.program->id == previousIds[k]) continue;
+        std::cout << "Reloaded shader program " << managed.name << std::endl;
+    }
+    
+    // Even if every rebuild failed, building left program 0 bound
+    return true;
+}
+
+void destroyPrograms(ProgramManager& manager) {
+    for (ManagedProgram& managed : manager.programs) {
+        destroyShaderProgram(*managed.program);
+    }
+    manager.programs.clear();
+}
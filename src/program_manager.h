@@ -0,0 +1,84 @@
+#pragma once
+
+#include "shader_program.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Owns every shader program the viewer uses and gets them linked quickly:
+//
+// - Linked binaries are cached on disk (glGetProgramBinary), keyed by a hash
+//   of the sources and the driver's vendor/renderer/version strings, so a
+//   restart on the same driver skips compilation entirely.
+// - Programs that do miss the cache are compiled together: every compile and
+//   link is issued before any status is queried, and with
+//   KHR/ARB_parallel_shader_compile the driver runs them on its own threads.
+// - With a shader directory, sources are read from <dir>/<name>.vert and
+//   <name>.frag (written from the built-in sources if missing) and programs
+//   are relinked when those files change.
+// - GLSL several programs share (uniform blocks, lighting functions) is
+//   registered once as a prelude and inserted after the #version line of
+//   each stage that asks for it, so the copies cannot drift apart.
+
+// Shared GLSL for the vertex and/or fragment stages
+struct ShaderPrelude {
+    std::string source;
+    bool vertexStage = false;
+    bool fragmentStage = false;
+};
+
+struct ManagedProgram {
+    ShaderProgram* program;
+    std::string name;
+    std::string vertexSource, fragmentSource;
+    const char* builtinVertex;
+    const char* builtinFragment;
+    unsigned int preludes = 0;          // Bits from addShaderPrelude
+
+    // Run after every successful (re)link, for uniforms that never change
+    std::function<void(ShaderProgram&)> setup;
+
+    // Hot reload state
+    std::string vertexPath, fragmentPath;
+    int64_t vertexStamp = 0, fragmentStamp = 0;
+};
+
+struct ProgramManager {
+    std::vector<ManagedProgram> programs;
+    std::vector<ShaderPrelude> preludes;
+    std::string cacheDir;
+    std::string shaderDir;              // Empty: built-in sources, no hot reload
+    std::string driverString;
+    bool binaryCache = false;
+    bool parallelCompile = false;
+    double lastReloadCheck = 0.0;
+};
+
+// How often the shader directory is checked for edits, in seconds
+const double shaderReloadInterval = 0.5;
+
+// Needs a current GL context. `shaderDir` may be null.
+void initProgramManager(ProgramManager& manager, const char* cacheDir, const char* shaderDir);
+
+// Register shared GLSL for the given stages, before buildPrograms. Returns
+// the bit that includes it in addProgram's `preludes`.
+unsigned int addShaderPrelude(ProgramManager& manager, std::string source, bool vertexStage, bool fragmentStage);
+
+// Register a program to be built by buildPrograms. `program` must outlive
+// the manager. The shader directory holds the sources without preludes.
+void addProgram(ProgramManager& manager, ShaderProgram& program, const char* name,
+                const char* vertexSource, const char* fragmentSource, unsigned int preludes,
+                std::function<void(ShaderProgram&)> setup = nullptr);
+
+// Link every registered program, from the binary cache where possible.
+// Returns false if any program failed to build.
+bool buildPrograms(ProgramManager& manager);
+
+// Relink programs whose files changed since they were last built. A program
+// that fails to rebuild keeps running its previous version. Returns true if
+// any program was rebuilt, whether or not it linked: the bound program is
+// then 0, and replaced programs have new ids and uniform locations.
+bool reloadChangedPrograms(ProgramManager& manager, double time);
+
+void destroyPrograms(ProgramManager& manager);
@@ -0,0 +1,34 @@
+#include "render_bodies.h"
+#include "../include/glm/gtc/packing.hpp"
+
+uint32_t packColor(const glm::vec3& color, float alpha) {
+    return glm::packUnorm4x8(glm::clamp(glm::vec4(color, alpha), 0.0f, 1.0f));
+}
+
+void gatherRenderBodies(const BodyList& bodies, RenderBodies& out) {
+    size_t count = bodies.size();
+    out.x.resize(count);
+    out.y.resize(count);
+    out.z.resize(count);
+    out.radius.resize(count);
+    out.mass.resize(count);
+    out.color.resize(count);
+    out.packedColor.resize(count);
+    out.emitters.clear();
+    out.emitterLuminosity.clear();
+    
+    for (size_t i = 0; i < count; ++i) {
+        const SpherePhysics& body = bodies[i];
+        out.x[i] = body.position.x;
+        out.y[i] = body.position.y;
+        out.z[i] = body.position.z;
+        out.radius[i] = body.radius;
+        out.mass[i] = body.mass;
+        out.color[i] = body.color;
+        out.packedColor[i] = packColor(body.color, body.luminosity > 0.0f ? 1.0f : 0.0f);
+        if (body.luminosity > 0.0f) {
+            out.emitters.push_back((uint32_t)i);
+            out.emitterLuminosity.push_back(body.luminosity);
+        }
+    }
+}
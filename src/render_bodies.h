@@ -0,0 +1,26 @@
+#pragma once
+
+#include "physics.h"
+#include <vector>
+
+// Render-relevant body state in structure-of-arrays form, so per-frame
+// passes over it (culling, LOD selection, instance writes) can run on
+// whole SIMD lanes of bodies at a time
+struct RenderBodies {
+    std::vector<float> x, y, z;
+    std::vector<float> radius;
+    std::vector<float> mass;
+    std::vector<glm::vec3> color;
+    std::vector<uint32_t> packedColor;     // RGBA8, as uploaded per instance
+    
+    // Light-emitting bodies, a small subset kept as an index list
+    std::vector<uint32_t> emitters;
+    std::vector<float> emitterLuminosity;
+    
+    size_t size() const { return x.size(); }
+};
+
+// RGBA8 color, each channel clamped to [0, 1]
+uint32_t packColor(const glm::vec3& color, float alpha = 1.0f);
+
+void gatherRenderBodies(const BodyList& bodies, RenderBodies& out);
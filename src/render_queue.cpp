@@ -0,0 +1,140 @@
+#include "render_queue.h"
+#include <algorithm>
+#include <cstring>
+
+void invalidateStateCache(GLStateCache& cache) {
+    cache.program = 0;
+    cache.vertexArray = 0;
+    cache.matrix3Values.clear();
+    cache.vectorValues.clear();
+    cache.intValues.clear();
+    cache.instanceBindings.clear();
+    glUseProgram(0);
+    glBindVertexArray(0);
+}
+
+void useProgram(GLStateCache& cache, unsigned int program) {
+    if (cache.program == program) return;
+    glUseProgram(program);
+    cache.program = program;
+    cache.stats.programBinds++;
+}
+
+void bindVertexArray(GLStateCache& cache, unsigned int vertexArray) {
+    if (cache.vertexArray == vertexArray) return;
+    glBindVertexArray(vertexArray);
+    cache.vertexArray = vertexArray;
+    cache.stats.vertexArrayBinds++;
+}
+
+// Uniform values are program state, so a value stays valid across binds
+static uint64_t uniformSlot(unsigned int program, int location) {
+    return ((uint64_t)program << 32) | (uint32_t)location;
+}
+
+void setUniformMatrix3(GLStateCache& cache, unsigned int program, int location, const glm::mat3& value) {
+    if (location < 0) return;
+
+    uint64_t slot = uniformSlot(program, location);
+    auto it = cache.matrix3Values.find(slot);
+    if (it != cache.matrix3Values.end() && std::memcmp(&it->second, &value, sizeof(glm::mat3)) == 0) return;
+
+    useProgram(cache, program);
+    glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
+    cache.matrix3Values[slot] = value;
+    cache.stats.uniformUploads++;
+    cache.stats.bytesUploaded += sizeof(glm::mat3);
+}
+
+// float and vec2 uniforms share one map; a float is stored as (value, 0)
+static void setUniformVector(GLStateCache& cache, unsigned int program, int location, const glm::vec2& value,
+                             int components) {
+    if (location < 0) return;
+
+    uint64_t slot = uniformSlot(program, location);
+    auto it = cache.vectorValues.find(slot);
+    if (it != cache.vectorValues.end() && std::memcmp(&it->second, &value, sizeof(glm::vec2)) == 0) return;
+
+    useProgram(cache, program);
+    if (components == 1) {
+        glUniform1f(location, value.x);
+    } else {
+        glUniform2f(location, value.x, value.y);
+    }
+    cache.vectorValues[slot] = value;
+    cache.stats.uniformUploads++;
+    cache.stats.bytesUploaded += components * sizeof(float);
+}
+
+void setUniformFloat(GLStateCache& cache, unsigned int program, int location, float value) {
+    setUniformVector(cache, program, location, glm::vec2(value, 0.0f), 1);
+}
+
+void setUniformVec2(GLStateCache& cache, unsigned int program, int location, const glm::vec2& value) {
+    setUniformVector(cache, program, location, value, 2);
+}
+
+void setUniformInt(GLStateCache& cache, unsigned int program, int location, int value) {
+    if (location < 0) return;
+
+    uint64_t slot = uniformSlot(program, location);
+    auto it = cache.intValues.find(slot);
+    if (it != cache.intValues.end() && it->second == value) return;
+
+    useProgram(cache, program);
+    glUniform1i(location, value);
+    cache.intValues[slot] = value;
+    cache.stats.uniformUploads++;
+    cache.stats.bytesUploaded += sizeof(int);
+}
+
+uint64_t makeSortKey(unsigned int layer, unsigned int program, unsigned int vertexArray) {
+    return ((uint64_t)(layer & 0xFF) << 56) |
+           ((uint64_t)(program & 0xFFFF) << 40) |
+           ((uint64_t)(vertexArray & 0xFFFF) << 24);
+}
+
+// Point the bound VAO's instance attributes at the item's data, unless the
+// last binding on that VAO already did
+static void bindInstances(GLStateCache& cache, const DrawItem& item) {
+    InstanceBinding& binding = cache.instanceBindings[item.vertexArray];
+    if (binding.bind == item.bindInstances && binding.buffer == item.instanceBuffer &&
+        binding.bufferVersion == item.instanceBufferVersion && binding.offset == item.instanceOffset) return;
+    item.bindInstances(item.instanceBuffer, item.instanceOffset);
+    binding.bind = item.bindInstances;
+    binding.buffer = item.instanceBuffer;
+    binding.bufferVersion = item.instanceBufferVersion;
+    binding.offset = item.instanceOffset;
+    cache.stats.instanceBinds++;
+}
+
+void flushRenderQueue(RenderQueue& queue, GLStateCache& cache, GpuTimers* timers) {
+    // Stable, so items with equal keys keep their submission order
+    std::stable_sort(queue.items.begin(), queue.items.end(),
+                     [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+
+    for (const DrawItem& item : queue.items) {
+        if (timers) switchGpuPass(*timers, item.gpuPass);
+        useProgram(cache, item.program);
+        bindVertexArray(cache, item.vertexArray);
+        if (item.bindInstances) bindInstances(cache, item);
+
+        switch (item.kind) {
+        case DrawArrays:
+            glDrawArrays(item.primitive, item.first, item.count);
+            break;
+        case DrawArraysInstanced:
+            glDrawArraysInstanced(item.primitive, item.first, item.count, item.instanceCount);
+            break;
+        case DrawElements:
+            glDrawElements(item.primitive, item.count, item.indexType, 0);
+            break;
+        case DrawElementsInstanced:
+            glDrawElementsInstanced(item.primitive, item.count, item.indexType, 0, item.instanceCount);
+            break;
+        }
+        cache.stats.drawCalls++;
+    }
+    if (timers) switchGpuPass(*timers, -1);
+    queue.items.clear();
+}
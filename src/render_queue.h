@@ -0,0 +1,117 @@
+#pragma once
+
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include "profiler.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Per-frame driver work, reported in the window title
+struct RenderStats {
+    uint32_t drawCalls = 0;
+    uint32_t programBinds = 0;
+    uint32_t vertexArrayBinds = 0;
+    uint32_t uniformUploads = 0;
+    uint32_t instanceBinds = 0;     // Per-instance attribute pointer setups
+    size_t bytesUploaded = 0;
+
+    uint32_t stateChanges() const { return programBinds + vertexArrayBinds + uniformUploads + instanceBinds; }
+};
+
+// Where a VAO's per-instance attributes were last pointed. Attribute
+// pointers are VAO state, so they stay valid while other VAOs are bound.
+struct InstanceBinding {
+    void (*bind)(unsigned int buffer, size_t offset) = nullptr;
+    unsigned int buffer = 0;
+    unsigned int bufferVersion = 0;
+    size_t offset = 0;
+};
+
+// Mirror of the GL binding state we change every frame. Binds and uniform
+// uploads go through it and are dropped when they would not change anything.
+// Code that binds programs or VAOs directly must call invalidateStateCache.
+struct GLStateCache {
+    unsigned int program = 0;
+    unsigned int vertexArray = 0;
+
+    // Last value uploaded to each (program, location), keyed program << 32 | location
+    std::unordered_map<uint64_t, glm::mat3> matrix3Values;
+    std::unordered_map<uint64_t, glm::vec2> vectorValues;  // float and vec2 uniforms (y = 0 for floats)
+    std::unordered_map<uint64_t, int> intValues;
+
+    // Keyed by VAO
+    std::unordered_map<unsigned int, InstanceBinding> instanceBindings;
+
+    RenderStats stats;
+};
+
+void invalidateStateCache(GLStateCache& cache);
+void useProgram(GLStateCache& cache, unsigned int program);
+void bindVertexArray(GLStateCache& cache, unsigned int vertexArray);
+void setUniformMatrix3(GLStateCache& cache, unsigned int program, int location, const glm::mat3& value);
+void setUniformFloat(GLStateCache& cache, unsigned int program, int location, float value);
+void setUniformVec2(GLStateCache& cache, unsigned int program, int location, const glm::vec2& value);
+void setUniformInt(GLStateCache& cache, unsigned int program, int location, int value);
+
+// Count bytes written to GL buffers this frame
+inline void recordUpload(GLStateCache& cache, size_t bytes) { cache.stats.bytesUploaded += bytes; }
+
+// Passes, in the order they are drawn
+enum RenderLayer {
+    LayerOpaque,
+    LayerBlended,
+    LayerOverlay
+};
+
+// Items are executed in ascending key order. The layer comes first so
+// passes keep their order (opaque, then blended, then overlays); within a
+// layer items sharing a program, then a VAO, end up adjacent.
+//
+//   bits 56-63  layer
+//   bits 40-55  program
+//   bits 24-39  vertex array
+uint64_t makeSortKey(unsigned int layer, unsigned int program, unsigned int vertexArray);
+
+enum DrawKind {
+    DrawArrays,
+    DrawArraysInstanced,
+    DrawElements,
+    DrawElementsInstanced
+};
+
+struct DrawItem {
+    uint64_t key = 0;
+    unsigned int program = 0;
+    unsigned int vertexArray = 0;
+
+    DrawKind kind = DrawArrays;
+    GLenum primitive = GL_TRIANGLES;
+    int first = 0;              // First vertex (array draws)
+    int count = 0;              // Vertex or index count
+    GLenum indexType = GL_UNSIGNED_INT;
+    int instanceCount = 1;
+
+    // Optional: points the VAO's per-instance attributes at this frame's
+    // data before drawing. Skipped when the VAO already points there.
+    void (*bindInstances)(unsigned int buffer, size_t offset) = nullptr;
+    unsigned int instanceBuffer = 0;
+    unsigned int instanceBufferVersion = 0;     // StreamBuffer::storageVersion, so a recreated buffer rebinds
+    size_t instanceOffset = 0;
+    
+    // GpuPass this item is timed under, or -1. A pass's items should be
+    // adjacent in key order (one program per pass does that), since each
+    // pass has only one query per frame.
+    int gpuPass = -1;
+};
+
+struct RenderQueue {
+    std::vector<DrawItem> items;
+};
+
+inline void submitDraw(RenderQueue& queue, const DrawItem& item) { queue.items.push_back(item); }
+
+// Sort the queued items by key, issue them through the state cache and
+// empty the queue. With `timers`, items are timed by their gpuPass.
+void flushRenderQueue(RenderQueue& queue, GLStateCache& cache, GpuTimers* timers = nullptr);
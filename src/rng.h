@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// xoshiro256** generator seeded through splitmix64. Each (seed, stream) pair
+// gives an independent sequence, so parallel generators can hand every block
+// of work its own stream and stay reproducible for any thread count.
+struct RandomStream {
+    uint64_t state[4];
+};
+
+inline uint64_t splitMix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+inline void seedRandomStream(RandomStream& rng, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+    for (uint64_t& word : rng.state) {
+        word = splitMix64(x);
+    }
+}
+
+inline uint64_t nextRandom(RandomStream& rng) {
+    uint64_t* s = rng.state;
+    uint64_t result = ((s[1] * 5) << 7 | (s[1] * 5) >> 57) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = s[3] << 45 | s[3] >> 19;
+    return result;
+}
+
+// Uniform in [0, 1)
+inline double randomUnit(RandomStream& rng) {
+    return (double)(nextRandom(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline double randomRange(RandomStream& rng, double low, double high) {
+    return low + (high - low) * randomUnit(rng);
+}
+
+// Standard normal deviate (Box-Muller)
+inline double randomGaussian(RandomStream& rng) {
+    double u1 = 1.0 - randomUnit(rng);
+    double u2 = randomUnit(rng);
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+}
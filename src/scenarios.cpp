@@ -0,0 +1,295 @@
+#include "scenarios.h"
+#include "parallel.h"
+#include "rng.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const double PI = 3.14159265358979323846;
+
+// Bodies per random stream; fixed so the output does not depend on thread count
+static const size_t sceneBlockSize = 4096;
+
+bool parseSceneType(const char* name, SceneType& type) {
+    static const struct { const char* name; SceneType type; } names[] = {
+        {"plummer", ScenePlummer},
+        {"king", SceneKing},
+        {"disk", SceneExponentialDisk},
+        {"sphere", SceneUniformSphere},
+        {"granular", SceneGranularBox},
+        {"lattice", SceneLattice}
+    };
+    for (const auto& entry : names) {
+        if (std::strcmp(name, entry.name) == 0) {
+            type = entry.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+static glm::vec3 randomDirection(RandomStream& rng) {
+    double z = randomRange(rng, -1.0, 1.0);
+    double phi = randomRange(rng, 0.0, 2.0 * PI);
+    double s = std::sqrt(1.0 - z * z);
+    return glm::vec3((float)(s * std::cos(phi)), (float)z, (float)(s * std::sin(phi)));
+}
+
+// Blue core fading to white at `outer`
+static glm::vec3 radialColor(float r, float outer) {
+    float t = glm::clamp(r / outer, 0.0f, 1.0f);
+    return glm::mix(glm::vec3(0.4f, 0.6f, 1.0f), glm::vec3(1.0f, 0.95f, 0.85f), t);
+}
+
+static SpherePhysics makeBody(const glm::vec3& position, const glm::vec3& velocity, float mass, float radius, const glm::vec3& color) {
+    SpherePhysics body;
+    body.position = position;
+    body.velocity = velocity;
+    body.acceleration = glm::vec3(0.0f, 0.0f, 0.0f);
+    body.mass = mass;
+    body.radius = radius;
+    body.bounceDamping = 0.9f;
+    body.color = color;
+    return body;
+}
+
+// Run fn(index, rng) for every body, one random stream per block of bodies
+template <typename Function>
+static void generateBlocks(size_t count, uint64_t seed, unsigned int threadCount, Function fn) {
+    size_t blockCount = (count + sceneBlockSize - 1) / sceneBlockSize;
+    parallelFor(0, blockCount, threadCount, [&](size_t blockBegin, size_t blockEnd, unsigned int) {
+        for (size_t block = blockBegin; block < blockEnd; ++block) {
+            RandomStream rng;
+            seedRandomStream(rng, seed, block);
+            size_t end = std::min(count, (block + 1) * sceneBlockSize);
+            for (size_t i = block * sceneBlockSize; i < end; ++i) {
+                fn(i, rng);
+            }
+        }
+    });
+}
+
+// Shift the centre of mass to the origin and remove any net momentum
+static void removeCenterOfMassMotion(BodyList& bodies) {
+    glm::dvec3 position(0.0), momentum(0.0);
+    double mass = 0.0;
+    for (const SpherePhysics& body : bodies) {
+        position += glm::dvec3(body.position) * (double)body.mass;
+        momentum += glm::dvec3(body.velocity) * (double)body.mass;
+        mass += body.mass;
+    }
+    if (mass <= 0.0) return;
+    glm::vec3 positionShift = glm::vec3(position / mass);
+    glm::vec3 velocityShift = glm::vec3(momentum / mass);
+    for (SpherePhysics& body : bodies) {
+        body.position -= positionShift;
+        body.velocity -= velocityShift;
+    }
+}
+
+// Plummer sphere via Aarseth, Henon & Wielen (1974)
+static void generatePlummer(const SceneParams& params, float radius, BodyList& bodies) {
+    double a = params.scale;
+    double mass = params.totalMass / (double)params.count;
+    double velocityScale = std::sqrt(gravitationalConstant * params.totalMass / a);
+    
+    generateBlocks(params.count, params.seed, params.threadCount, [&](size_t i, RandomStream& rng) {
+        // Radius from the inverted cumulative mass profile, cut off at 10 scale radii
+        double r;
+        do {
+            double x = randomRange(rng, 1e-10, 1.0);
+            r = a / std::sqrt(std::pow(x, -2.0 / 3.0) - 1.0);
+        } while (r > 10.0 * a);
+        
+        // Speed as a fraction q of the local escape speed, g(q) = q^2 (1 - q^2)^3.5
+        double q, g;
+        do {
+            q = randomUnit(rng);
+            g = randomRange(rng, 0.0, 0.1);
+        } while (g > q * q * std::pow(1.0 - q * q, 3.5));
+        double escape = std::sqrt(2.0) * velocityScale * std::pow(1.0 + r * r / (a * a), -0.25);
+        
+        bodies[i] = makeBody(randomDirection(rng) * (float)r, randomDirection(rng) * (float)(q * escape),
+                             (float)mass, radius, radialColor((float)r, (float)(3.0 * a)));
+    });
+    removeCenterOfMassMotion(bodies);
+}
+
+// Density of a lowered isothermal (King) model relative to exp(W) scaling
+static double kingDensity(double W) {
+    if (W <= 0.0) return 0.0;
+    return std::exp(W) * std::erf(std::sqrt(W)) - std::sqrt(4.0 * W / PI) * (1.0 + 2.0 * W / 3.0);
+}
+
+// King (1966) model. The dimensionless potential W(r) is integrated outwards
+// from W0 with RK4 (r in core radii, d2W/dr2 + 2/r dW/dr = -9 rho/rho0) until
+// it reaches zero at the tidal radius; radii are then drawn from the
+// tabulated mass profile and speeds from the lowered Maxwellian at W(r).
+static void generateKing(const SceneParams& params, float radius, BodyList& bodies) {
+    double W0 = std::max(0.5, (double)params.kingW0);
+    double rho0 = kingDensity(W0);
+    const double dr = 1e-3;
+    
+    std::vector<double> tableR, tableW, tableMass;
+    double r = 1e-6, W = W0, dW = 0.0, mass = 0.0;
+    auto derivative = [&](double rr, double w, double dw) { return -9.0 * kingDensity(w) / rho0 - 2.0 / rr * dw; };
+    while (W > 0.0 && r < 1e3) {
+        tableR.push_back(r);
+        tableW.push_back(W);
+        tableMass.push_back(mass);
+        
+        double k1w = dW, k1d = derivative(r, W, dW);
+        double k2w = dW + 0.5 * dr * k1d, k2d = derivative(r + 0.5 * dr, W + 0.5 * dr * k1w, k2w);
+        double k3w = dW + 0.5 * dr * k2d, k3d = derivative(r + 0.5 * dr, W + 0.5 * dr * k2w, k3w);
+        double k4w = dW + dr * k3d, k4d = derivative(r + dr, W + dr * k3w, k4w);
+        mass += 4.0 * PI * r * r * kingDensity(W) / rho0 * dr;
+        W += dr / 6.0 * (k1w + 2.0 * k2w + 2.0 * k3w + k4w);
+        dW += dr / 6.0 * (k1d + 2.0 * k2d + 2.0 * k3d + k4d);
+        r += dr;
+    }
+    double totalMass = mass;
+    double tidalRadius = r;
+    
+    // Physical units: core radius = scale, and rho0 r0^3 * totalMass = M,
+    // with r0^2 = 9 sigma^2 / (4 pi G rho0) fixing the velocity dispersion
+    double r0 = params.scale;
+    double physicalRho0 = params.totalMass / (r0 * r0 * r0 * totalMass);
+    double sigma = std::sqrt(4.0 * PI * gravitationalConstant * physicalRho0 * r0 * r0 / 9.0);
+    double bodyMass = params.totalMass / (double)params.count;
+    
+    generateBlocks(params.count, params.seed, params.threadCount, [&](size_t i, RandomStream& rng) {
+        double target = randomUnit(rng) * totalMass;
+        size_t k = std::upper_bound(tableMass.begin(), tableMass.end(), target) - tableMass.begin();
+        k = std::min(std::max<size_t>(k, 1), tableMass.size() - 1);
+        double t = (target - tableMass[k - 1]) / std::max(1e-300, tableMass[k] - tableMass[k - 1]);
+        double rr = tableR[k - 1] + t * (tableR[k] - tableR[k - 1]);
+        double w = std::max(1e-9, tableW[k - 1] + t * (tableW[k] - tableW[k - 1]));
+        
+        // v in units of sigma: f(v) ~ v^2 (exp(w - v^2/2) - 1) for v^2 < 2w
+        double vMax = std::sqrt(2.0 * w);
+        double bound = w >= 1.0 ? 2.0 * std::exp(w - 1.0) : 2.0 * w;
+        double v, g;
+        do {
+            v = randomUnit(rng) * vMax;
+            g = randomUnit(rng) * bound;
+        } while (g > v * v * (std::exp(w - 0.5 * v * v) - 1.0));
+        
+        bodies[i] = makeBody(randomDirection(rng) * (float)(rr * r0), randomDirection(rng) * (float)(v * sigma),
+                             (float)bodyMass, radius, radialColor((float)rr, (float)(0.5 * tidalRadius)));
+    });
+    removeCenterOfMassMotion(bodies);
+}
+
+// Exponential disk, surface density ~ exp(-R / Rd), truncated at 6 Rd. Bodies
+// move on circular orbits using Freeman's (1970) thin-disk rotation curve plus
+// the optional central mass.
+static void generateExponentialDisk(const SceneParams& params, float radius, BodyList& bodies) {
+    double Rd = params.scale;
+    double diskMass = params.totalMass;
+    double sigma0 = diskMass / (2.0 * PI * Rd * Rd);
+    double thickness = 0.05 * Rd;
+    double bodyMass = diskMass / (double)params.count;
+    double centralMass = params.diskCentralMass;
+    
+    const double xMax = 6.0;
+    double massFractionMax = 1.0 - (1.0 + xMax) * std::exp(-xMax);
+    
+    generateBlocks(params.count, params.seed, params.threadCount, [&](size_t i, RandomStream& rng) {
+        // Invert m(x) = 1 - (1 + x) exp(-x) with Newton's method
+        double target = randomUnit(rng) * massFractionMax;
+        double x = 1.0;
+        for (int iteration = 0; iteration < 20; ++iteration) {
+            double m = 1.0 - (1.0 + x) * std::exp(-x);
+            x -= (m - target) / std::max(1e-12, x * std::exp(-x));
+            x = glm::clamp(x, 1e-6, xMax);
+        }
+        double R = x * Rd;
+        double phi = randomRange(rng, 0.0, 2.0 * PI);
+        double z = thickness * std::atanh(randomRange(rng, -0.999, 0.999));
+        
+        double y = R / (2.0 * Rd);
+        double vSq = 4.0 * PI * gravitationalConstant * sigma0 * Rd * y * y
+            * (std::cyl_bessel_i(0.0, y) * std::cyl_bessel_k(0.0, y) - std::cyl_bessel_i(1.0, y) * std::cyl_bessel_k(1.0, y));
+        vSq += gravitationalConstant * centralMass / R;
+        double v = std::sqrt(std::max(0.0, vSq));
+        
+        glm::vec3 position((float)(R * std::cos(phi)), (float)z, (float)(R * std::sin(phi)));
+        glm::vec3 velocity((float)(-v * std::sin(phi)), 0.0f, (float)(v * std::cos(phi)));
+        // Small random motions so the disk is not perfectly cold
+        velocity += glm::vec3((float)randomGaussian(rng), (float)randomGaussian(rng), (float)randomGaussian(rng)) * (float)(0.02 * v);
+        
+        bodies[i] = makeBody(position, velocity, (float)bodyMass, radius, radialColor((float)R, (float)(3.0 * Rd)));
+    });
+    
+    if (centralMass > 0.0) {
+        bodies.push_back(makeBody(glm::vec3(0.0f), glm::vec3(0.0f), (float)centralMass, radius * 4.0f, glm::vec3(1.0f, 0.9f, 0.5f)));
+    }
+}
+
+static void generateUniformSphere(const SceneParams& params, float radius, BodyList& bodies) {
+    float mass = params.totalMass / (float)params.count;
+    generateBlocks(params.count, params.seed, params.threadCount, [&](size_t i, RandomStream& rng) {
+        float r = params.scale * (float)std::cbrt(randomUnit(rng));
+        bodies[i] = makeBody(randomDirection(rng) * r, glm::vec3(0.0f), mass, radius, radialColor(r, params.scale));
+    });
+}
+
+// Cubic lattice filling a box of half-size `scale`. With `jitter` each body is
+// displaced randomly within the free space of its cell, which gives a random
+// packing that never starts with overlapping spheres.
+static void generateBox(const SceneParams& params, float radius, bool jitter, BodyList& bodies) {
+    size_t perSide = (size_t)std::ceil(std::cbrt((double)params.count));
+    float spacing = 2.0f * params.scale / (float)perSide;
+    radius = std::min(radius, 0.5f * spacing);
+    float freeSpace = 0.5f * spacing - radius;
+    float mass = params.totalMass / (float)params.count;
+    
+    generateBlocks(params.count, params.seed, params.threadCount, [&](size_t i, RandomStream& rng) {
+        size_t ix = i % perSide;
+        size_t iy = (i / perSide) % perSide;
+        size_t iz = i / (perSide * perSide);
+        glm::vec3 position = glm::vec3(-params.scale) + spacing * (glm::vec3((float)ix, (float)iy, (float)iz) + 0.5f);
+        glm::vec3 velocity(0.0f);
+        if (jitter) {
+            position += glm::vec3((float)randomRange(rng, -1.0, 1.0), (float)randomRange(rng, -1.0, 1.0),
+                                  (float)randomRange(rng, -1.0, 1.0)) * freeSpace;
+            velocity = randomDirection(rng) * (float)randomUnit(rng);
+        }
+        glm::vec3 color = glm::vec3(ix, iy, iz) / (float)perSide * 0.7f + 0.3f;
+        bodies[i] = makeBody(position, velocity, mass, radius, color);
+    });
+}
+
+void generateScene(const SceneParams& params, BodyList& bodies) {
+    SceneParams resolved = params;
+    if (resolved.count == 0) resolved.count = 1;
+    if (resolved.threadCount == 0) resolved.threadCount = hardwareThreadCount();
+    
+    // Default body size: a tenth of the mean spacing of N bodies in the scale volume
+    float radius = resolved.bodyRadius;
+    if (radius <= 0.0f) {
+        radius = 0.1f * resolved.scale / (float)std::cbrt((double)resolved.count);
+    }
+    
+    bodies.resize(resolved.count);
+    switch (resolved.type) {
+        case ScenePlummer: generatePlummer(resolved, radius, bodies); break;
+        case SceneKing: generateKing(resolved, radius, bodies); break;
+        case SceneExponentialDisk: generateExponentialDisk(resolved, radius, bodies); break;
+        case SceneUniformSphere: generateUniformSphere(resolved, radius, bodies); break;
+        case SceneGranularBox: generateBox(resolved, radius, true, bodies); break;
+        case SceneLattice: generateBox(resolved, radius, false, bodies); break;
+    }
+    
+    // Every (count / starCount)-th body shines, so stars follow the scene's
+    // own distribution and the same seed always picks the same ones
+    size_t starCount = std::min(resolved.starCount, bodies.size());
+    const glm::vec3 starColors[4] = {
+        glm::vec3(1.0f, 0.85f, 0.6f), glm::vec3(1.0f, 0.95f, 0.85f),
+        glm::vec3(1.0f, 0.7f, 0.45f), glm::vec3(0.8f, 0.88f, 1.0f)};
+    for (size_t k = 0; k < starCount; ++k) {
+        SpherePhysics& star = bodies[k * bodies.size() / starCount];
+        star.luminosity = resolved.starLuminosity;
+        star.color = starColors[k % 4];
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "physics.h"
+#include <cstdint>
+#include <vector>
+
+// Built-in initial conditions
+enum SceneType {
+    ScenePlummer,           // Plummer sphere in virial equilibrium
+    SceneKing,              // King (1966) cluster with central potential kingW0
+    SceneExponentialDisk,   // Thin exponential disk on circular orbits in the XZ plane
+    SceneUniformSphere,     // Cold (zero velocity) uniform-density sphere
+    SceneGranularBox,       // Randomly packed, non-overlapping spheres in a cube
+    SceneLattice            // Regular cubic lattice at rest
+};
+
+struct SceneParams {
+    SceneType type = ScenePlummer;
+    size_t count = 1000;
+    uint64_t seed = 1;
+    float totalMass = 100.0f;
+    float scale = 20.0f;            // Plummer/King/disk scale radius, sphere radius or box half-size
+    float bodyRadius = 0.0f;        // 0 picks a radius from the scale and body count
+    float kingW0 = 6.0f;
+    float diskCentralMass = 0.0f;   // Extra point mass at the disk centre (adds a body)
+    size_t starCount = 0;           // Bodies turned into light-emitting stars, spread evenly
+    float starLuminosity = 2.0f;
+    unsigned int threadCount = 0;   // 0 uses every hardware thread
+};
+
+bool parseSceneType(const char* name, SceneType& type);
+
+// Replace `bodies` with the requested scene. Bodies are generated in fixed
+// blocks with one random stream per block, so the same seed gives the same
+// scene no matter how many threads fill it.
+void generateScene(const SceneParams& params, BodyList& bodies);
@@ -0,0 +1,75 @@
+#include "shader_program.h"
+#include <iostream>
+#include <vector>
+
+const char* const frameDataBlockSource = R"(
+    layout (std140) uniform FrameData {
+        mat4 view;
+        mat4 projection;
+        vec4 cameraPos;
+        vec4 lightPos;
+        vec4 lightColor;
+        vec4 clusterParams;
+    };
+)";
+
+// Function to check shader compilation errors
+void checkShaderCompilation(unsigned int shader, const char* type) {
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "ERROR: " << type << " shader compilation failed\n" << infoLog << std::endl;
+    }
+}
+
+// Function to check shader program linking errors
+void checkProgramLinking(unsigned int program) {
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "ERROR: Shader program linking failed\n" << infoLog << std::endl;
+    }
+}
+
+void resolveProgramInterface(ShaderProgram& program) {
+    program.uniforms.clear();
+    
+    int uniformCount = 0;
+    int maxNameLength = 0;
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    
+    std::vector<char> name(maxNameLength > 0 ? maxNameLength : 1);
+    for (int i = 0; i < uniformCount; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program.id, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        
+        // Block members have no location; arrays are reported as "name[0]"
+        int location = glGetUniformLocation(program.id, name.data());
+        if (location < 0) continue;
+        std::string key(name.data(), length);
+        if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) key.resize(key.size() - 3);
+        program.uniforms[key] = location;
+    }
+    
+    unsigned int blockIndex = glGetUniformBlockIndex(program.id, "FrameData");
+    if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program.id, blockIndex, frameDataBinding);
+    }
+}
+
+void destroyShaderProgram(ShaderProgram& program) {
+    if (program.id) glDeleteProgram(program.id);
+    program = ShaderProgram();
+}
+
+int uniformLocation(const ShaderProgram& program, const char* name) {
+    auto it = program.uniforms.find(name);
+    return it != program.uniforms.end() ? it->second : -1;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+// Linked program plus every active uniform location, resolved once at link
+// time so the render loop never calls glGetUniformLocation
+struct ShaderProgram {
+    unsigned int id = 0;
+    std::unordered_map<std::string, int> uniforms;
+};
+
+// Per-frame state shared by every program through one std140 uniform
+// block, declared in GLSL by frameDataBlockSource (added to programs as a
+// ProgramManager prelude). Programs that declare the block are bound to
+// frameDataBinding at link time.
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 cameraPos;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+    glm::vec4 clusterParams;    // LightClusters::shaderParams
+};
+
+// The block is uploaded with one glBufferSubData of the whole struct, so it
+// must match std140's offsets exactly
+static_assert(offsetof(FrameData, view) == 0, "FrameData must match its std140 block");
+static_assert(offsetof(FrameData, projection) == 64, "FrameData must match its std140 block");
+static_assert(offsetof(FrameData, cameraPos) == 128, "FrameData must match its std140 block");
+static_assert(offsetof(FrameData, lightPos) == 144, "FrameData must match its std140 block");
+static_assert(offsetof(FrameData, lightColor) == 160, "FrameData must match its std140 block");
+static_assert(offsetof(FrameData, clusterParams) == 176, "FrameData must match its std140 block");
+static_assert(sizeof(FrameData) == 192, "FrameData must match its std140 block");
+
+// GLSL declaration of the FrameData block; the one copy every program uses
+extern const char* const frameDataBlockSource;
+
+const unsigned int frameDataBinding = 0;
+
+void checkShaderCompilation(unsigned int shader, const char* type);
+void checkProgramLinking(unsigned int program);
+
+void destroyShaderProgram(ShaderProgram& program);
+
+// Record every active uniform's location of the linked program.id and bind
+// its FrameData block
+void resolveProgramInterface(ShaderProgram& program);
+
+// Location of `name`, or -1 if the program has no such active uniform
+int uniformLocation(const ShaderProgram& program, const char* name);
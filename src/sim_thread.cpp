@@ -0,0 +1,142 @@
+#include "sim_thread.h"
+#include "tracer.h"
+#include <cctype>
+#include <chrono>
+#include <functional>
+
+static void publishBodies(SimThread& sim, uint64_t stepCount) {
+    TRACE_ZONE("publishBodies");
+    SimSnapshot& snapshot = snapshotWriteSlot(sim.snapshots);
+    gatherRenderBodies(*sim.bodies, snapshot.bodies);
+    snapshot.stepCount = stepCount;
+    publishSnapshot(sim.snapshots);
+}
+
+// Miss counters get per-body and per-interaction columns, as in the overlay
+static const PerfCounter missCounters[] = {CounterL1Misses, CounterLLCMisses, CounterBranchMisses};
+
+// "l1d misses" becomes "gravity_l1d_misses" plus `suffix`
+static void writeCounterColumn(FILE* file, const char* pass, PerfCounter counter, const char* suffix) {
+    std::fprintf(file, ",%s_", pass);
+    for (const char* c = perfCounterNames[counter]; *c; ++c) {
+        std::fputc(*c == ' ' ? '_' : std::tolower((unsigned char)*c), file);
+    }
+    std::fputs(suffix, file);
+}
+
+static void writeCounterColumns(FILE* file, const char* pass) {
+    for (int counter = 0; counter < CounterCount; ++counter) {
+        writeCounterColumn(file, pass, (PerfCounter)counter, "");
+    }
+    std::fprintf(file, ",%s_ipc", pass);
+    for (PerfCounter counter : missCounters) {
+        writeCounterColumn(file, pass, counter, "_per_body");
+        writeCounterColumn(file, pass, counter, "_per_interaction");
+    }
+}
+
+// Negative ratios are perfCounterRatio's "unavailable"
+static void writeRatio(FILE* file, double ratio) {
+    if (ratio >= 0.0) {
+        std::fprintf(file, ",%.6g", ratio);
+    } else {
+        std::fputc(',', file);
+    }
+}
+
+// Unavailable counters, and ratios of them, are left empty rather than
+// written as zero
+static void writeCounterValues(FILE* file, const PerfCounterSample& sample, size_t bodyCount, double interactions) {
+    for (int counter = 0; counter < CounterCount; ++counter) {
+        if (hasPerfCounter(sample, (PerfCounter)counter)) {
+            std::fprintf(file, ",%llu", (unsigned long long)sample.values[counter]);
+        } else {
+            std::fputc(',', file);
+        }
+    }
+    double cycles = hasPerfCounter(sample, CounterCycles) ? (double)sample.values[CounterCycles] : 0.0;
+    writeRatio(file, perfCounterRatio(sample, CounterInstructions, cycles));
+    for (PerfCounter counter : missCounters) {
+        writeRatio(file, perfCounterRatio(sample, counter, (double)bodyCount));
+        writeRatio(file, perfCounterRatio(sample, counter, interactions));
+    }
+}
+
+static void writeCounterHeader(FILE* file) {
+    std::fprintf(file, "step,time_s,bodies,gravity_ms,integrate_ms,collisions_ms");
+    writeCounterColumns(file, "gravity");
+    writeCounterColumns(file, "collision");
+    std::fputc('\n', file);
+}
+
+static void writeCounterRow(FILE* file, uint64_t stepCount, double simulationTime, const StepTimings& timings) {
+    std::fprintf(file, "%llu,%.6f,%zu,%.4f,%.4f,%.4f", (unsigned long long)stepCount, simulationTime,
+                 timings.bodyCount, timings.gravity, timings.integrate, timings.collisions);
+    writeCounterValues(file, timings.gravityCounters, timings.bodyCount, gravityInteractions(timings.bodyCount));
+    writeCounterValues(file, timings.collisionCounters, timings.bodyCount, collisionInteractions(timings.bodyCount));
+    std::fputc('\n', file);
+}
+
+static void runSimulation(SimThread& sim) {
+    TRACE_THREAD_NAME("simulation");
+
+    // Opened here so they follow this thread (and the workers it starts)
+    PerfCounters counters;
+    bool countersOpen = sim.countersFile && openPerfCounters(counters);
+    if (sim.countersFile) writeCounterHeader(sim.countersFile);
+
+    using Clock = std::chrono::steady_clock;
+    const auto minInterval = std::chrono::duration<double>(simMinStepInterval);
+
+    uint64_t stepCount = 0;
+    double simulationTime = 0.0;
+    auto lastStep = Clock::now();
+
+    while (sim.running.load(std::memory_order_relaxed)) {
+        auto now = Clock::now();
+        if (now - lastStep < minInterval) {
+            std::this_thread::sleep_for(minInterval - (now - lastStep));
+            continue;
+        }
+
+        // Paused: nothing changes, so there is nothing to step, count or
+        // publish. The clock keeps moving so resuming takes a normal step.
+        if (!playback.load(std::memory_order_relaxed)) {
+            lastStep = now;
+            continue;
+        }
+        float deltaTime = std::chrono::duration<float>(now - lastStep).count();
+        lastStep = now;
+
+        StepTimings timings;
+        stepPhysics(*sim.bodies, deltaTime, &timings, countersOpen ? &counters : nullptr);
+        stepCount++;
+        simulationTime += deltaTime;
+
+        if (sim.recorder) {
+            TRACE_ZONE("recordFrame");
+            appendTrajectoryFrame(*sim.recorder, *sim.bodies, simulationTime);
+        }
+        if (sim.countersFile) writeCounterRow(sim.countersFile, stepCount, simulationTime, timings);
+        pushRing(sim.stepTimings, timings);
+        publishBodies(sim, stepCount);
+    }
+
+    if (countersOpen) closePerfCounters(counters);
+}
+
+void startSimThread(SimThread& sim, BodyList& bodies, TrajectoryWriter* recorder) {
+    sim.bodies = &bodies;
+    sim.recorder = recorder;
+
+    // The GL thread has something to draw before the first step lands
+    publishBodies(sim, 0);
+
+    sim.running = true;
+    sim.thread = std::thread(runSimulation, std::ref(sim));
+}
+
+void stopSimThread(SimThread& sim) {
+    sim.running = false;
+    if (sim.thread.joinable()) sim.thread.join();
+}
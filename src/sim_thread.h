@@ -0,0 +1,46 @@
+#pragma once
+
+#include "physics.h"
+#include "render_bodies.h"
+#include "spsc_ring.h"
+#include "trajectory.h"
+#include "triple_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// What the GL thread needs from one simulation step
+struct SimSnapshot {
+    RenderBodies bodies;
+    uint64_t stepCount = 0;
+};
+
+// Steps' timings waiting for the GL thread; over a second of steps at the
+// fastest step rate, so a stalled frame or two loses none
+const size_t stepTimingRingSize = 2048;
+
+// The simulation runs on its own thread at its own rate and publishes a
+// snapshot after every step; the GL thread takes the newest one each frame.
+// Every step's timings also go through `stepTimings`, so the GL thread
+// samples the steps behind snapshots it never saw as well.
+// While the thread runs it owns `bodies` and the recorder.
+struct SimThread {
+    std::thread thread;
+    std::atomic<bool> running{false};
+    TripleBuffer<SimSnapshot> snapshots;
+    SpscRing<StepTimings, stepTimingRingSize> stepTimings;
+
+    BodyList* bodies = nullptr;
+    TrajectoryWriter* recorder = nullptr;   // Optional; every step is appended while playing
+    FILE* countersFile = nullptr;           // Optional; one CSV row of perf counters per step
+};
+
+// Steps never run closer together than this, so a light scene does not
+// spin a core for steps nobody will see (at most 1000 steps per second)
+const double simMinStepInterval = 0.001;
+
+// Publish the initial state, then start stepping `bodies`
+void startSimThread(SimThread& sim, BodyList& bodies, TrajectoryWriter* recorder);
+void stopSimThread(SimThread& sim);
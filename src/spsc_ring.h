@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free single-producer, single-consumer queue of up to Capacity items.
+//
+// Unlike TripleBuffer, which only hands over the newest snapshot, every
+// pushed item reaches the reader in order. The writer never waits: if the
+// reader falls a whole ring behind, pushRing drops the new item and counts
+// it instead.
+template <typename T, size_t Capacity>
+struct SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Ring capacity must be a power of two");
+
+    T items[Capacity];
+    std::atomic<uint64_t> written{0};   // Advanced by the writer after filling an item
+    std::atomic<uint64_t> read{0};      // Advanced by the reader after taking an item
+    std::atomic<uint64_t> dropped{0};   // Items pushed while the ring was full
+};
+
+template <typename T, size_t Capacity>
+bool pushRing(SpscRing<T, Capacity>& ring, const T& item) {
+    uint64_t written = ring.written.load(std::memory_order_relaxed);
+    if (written - ring.read.load(std::memory_order_acquire) == Capacity) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ring.items[written & (Capacity - 1)] = item;
+    ring.written.store(written + 1, std::memory_order_release);
+    return true;
+}
+
+// Take the oldest item, if any. Returns false when the ring is empty.
+template <typename T, size_t Capacity>
+bool popRing(SpscRing<T, Capacity>& ring, T& item) {
+    uint64_t read = ring.read.load(std::memory_order_relaxed);
+    if (read == ring.written.load(std::memory_order_acquire)) return false;
+    item = ring.items[read & (Capacity - 1)];
+    ring.read.store(read + 1, std::memory_order_release);
+    return true;
+}
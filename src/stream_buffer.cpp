@@ -0,0 +1,116 @@
+#include "stream_buffer.h"
+#include "tracer.h"
+#include <iostream>
+
+static void allocateStorage(StreamBuffer& stream) {
+    GLsizeiptr capacity = (GLsizeiptr)(stream.segmentSize * streamBufferSegments);
+    
+    glGenBuffers(1, &stream.buffer);
+    glBindBuffer(stream.target, stream.buffer);
+    stream.storageVersion++;
+    
+    if (stream.persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(stream.target, capacity, NULL, flags);
+        stream.mapped = static_cast<unsigned char*>(glMapBufferRange(stream.target, 0, capacity, flags));
+        if (!stream.mapped) {
+            // Some drivers expose the extension but refuse the mapping
+            std::cerr << "WARNING: Persistent buffer mapping failed, using buffer orphaning" << std::endl;
+            glDeleteBuffers(1, &stream.buffer);
+            stream.persistent = false;
+            allocateStorage(stream);
+        }
+    } else {
+        glBufferData(stream.target, capacity, NULL, GL_STREAM_DRAW);
+    }
+    stream.segment = 0;
+    stream.writeOffset = 0;
+}
+
+static void releaseStorage(StreamBuffer& stream) {
+    for (GLsync& fence : stream.fences) {
+        if (fence) glDeleteSync(fence);
+        fence = 0;
+    }
+    if (stream.buffer) {
+        if (stream.mapped) {
+            glBindBuffer(stream.target, stream.buffer);
+            glUnmapBuffer(stream.target);
+        }
+        glDeleteBuffers(1, &stream.buffer);
+    }
+    stream.buffer = 0;
+    stream.mapped = nullptr;
+}
+
+bool createStreamBuffer(StreamBuffer& stream, GLenum target, size_t segmentSize) {
+    stream.target = target;
+    stream.segmentSize = segmentSize > 0 ? segmentSize : 1;
+    stream.persistent = GLAD_GL_ARB_buffer_storage != 0;
+    allocateStorage(stream);
+    return stream.buffer != 0;
+}
+
+void destroyStreamBuffer(StreamBuffer& stream) {
+    releaseStorage(stream);
+}
+
+void* beginStreamWrite(StreamBuffer& stream, size_t size, size_t& offset) {
+    TRACE_ZONE("beginStreamWrite");
+    if (size > stream.segmentSize) {
+        // Grow with headroom so a slowly growing body count does not reallocate every frame
+        releaseStorage(stream);
+        stream.segmentSize = size + size / 2;
+        allocateStorage(stream);
+    }
+    glBindBuffer(stream.target, stream.buffer);
+    
+    if (stream.persistent) {
+        stream.segment = (stream.segment + 1) % streamBufferSegments;
+        
+        // Wait until the GPU is done with the frame that last used this segment
+        GLsync& fence = stream.fences[stream.segment];
+        if (fence) {
+            GLenum result = glClientWaitSync(fence, 0, 0);
+            while (result == GL_TIMEOUT_EXPIRED) {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync(fence);
+            fence = 0;
+        }
+        
+        offset = stream.segment * stream.segmentSize;
+        return stream.mapped + offset;
+    }
+    
+    // Append after the previous write; once the ring is full, orphan the old
+    // storage (the driver keeps it alive for in-flight draws) and start over
+    size_t capacity = stream.segmentSize * streamBufferSegments;
+    if (stream.writeOffset + size > capacity) {
+        glBufferData(stream.target, (GLsizeiptr)capacity, NULL, GL_STREAM_DRAW);
+        stream.writeOffset = 0;
+    }
+    offset = stream.writeOffset;
+    stream.writeOffset += size;
+    
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    void* pointer = glMapBufferRange(stream.target, (GLintptr)offset, (GLsizeiptr)(size > 0 ? size : 1), access);
+    stream.mappedRange = pointer != nullptr;
+    return pointer;
+}
+
+void endStreamWrite(StreamBuffer& stream) {
+    if (stream.persistent || !stream.mappedRange) return;
+    
+    glBindBuffer(stream.target, stream.buffer);
+    glUnmapBuffer(stream.target);
+    stream.mappedRange = false;
+}
+
+void fenceStreamWrite(StreamBuffer& stream) {
+    if (!stream.persistent) return;
+    
+    GLsync& fence = stream.fences[stream.segment];
+    if (fence) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
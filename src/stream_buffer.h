@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../include/glad/glad.h"
+#include <cstddef>
+
+// Ring buffer for data that is rewritten every frame (instance attributes).
+//
+// With GL_ARB_buffer_storage the whole ring is mapped once, persistently and
+// coherently; each frame writes into the next of three segments, and a fence
+// per segment makes sure the GPU has finished reading a segment before the
+// CPU overwrites it. Plain GL 3.3 contexts fall back to unsynchronized
+// glMapBufferRange appends, orphaning the buffer when the ring wraps.
+//
+// Either way callers get a pointer into GL memory and write their data there
+// directly, with no staging copy.
+struct StreamBuffer {
+    unsigned int buffer = 0;
+    GLenum target = GL_ARRAY_BUFFER;
+    size_t segmentSize = 0;
+    bool persistent = false;
+    unsigned int storageVersion = 0;    // Bumped whenever `buffer` is recreated (its name may be reused)
+    
+    // Persistent path
+    unsigned char* mapped = nullptr;
+    GLsync fences[3] = {};
+    int segment = 0;
+    
+    // Fallback path
+    size_t writeOffset = 0;
+    bool mappedRange = false;
+};
+
+const int streamBufferSegments = 3;
+
+bool createStreamBuffer(StreamBuffer& stream, GLenum target, size_t segmentSize);
+void destroyStreamBuffer(StreamBuffer& stream);
+
+// Reserve `size` bytes for this frame and return a write pointer to them.
+// `offset` receives the buffer offset the data will live at (for attribute
+// pointers). The buffer is grown if `size` does not fit in a segment.
+void* beginStreamWrite(StreamBuffer& stream, size_t size, size_t& offset);
+void endStreamWrite(StreamBuffer& stream);
+
+// Call once the draws reading this frame's data have been issued
+void fenceStreamWrite(StreamBuffer& stream);
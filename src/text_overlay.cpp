@@ -0,0 +1,197 @@
+#include "text_overlay.h"
+#include "tracer.h"
+
+// Glyphs for ' ' (32) through '_' (95), one byte per row, top row first,
+// bit 4 the leftmost column
+static const unsigned char fontGlyphs[64][7] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // '!'
+    {0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00}, // '"'
+    {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}, // '#'
+    {0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04}, // '$'
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // '%'
+    {0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D}, // '&'
+    {0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00}, // '\''
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // '('
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // ')'
+    {0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00}, // '*'
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}, // ','
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // '.'
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // '/'
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // '0'
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // '1'
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // '2'
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // '3'
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // '4'
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // '5'
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // '6'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // '7'
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // '8'
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // '9'
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // ':'
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08}, // ';'
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // '<'
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // '='
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // '>'
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // '?'
+    {0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E}, // '@'
+    {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'A'
+    {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // 'B'
+    {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // 'C'
+    {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}, // 'D'
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // 'E'
+    {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // 'F'
+    {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // 'G'
+    {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'H'
+    {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 'I'
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // 'J'
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // 'K'
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // 'L'
+    {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // 'M'
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // 'N'
+    {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'O'
+    {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // 'P'
+    {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // 'Q'
+    {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // 'R'
+    {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // 'S'
+    {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // 'T'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'U'
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // 'V'
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // 'W'
+    {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // 'X'
+    {0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04}, // 'Y'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // 'Z'
+    {0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E}, // '['
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // '\\'
+    {0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E}, // ']'
+    {0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00}, // '^'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}, // '_'
+};
+
+// The atlas holds the 64 glyphs followed by one solid cell for panels
+static const int fontGlyphCount = 64;
+static const int fontAtlasWidth = (fontGlyphCount + 1) * textCellWidth;
+static const int fontAtlasHeight = textCellHeight;
+static const int vertexFloats = 8; // position (2), texture coordinate (2), color (4)
+
+void createTextOverlay(TextOverlay& overlay) {
+    std::vector<unsigned char> atlas(fontAtlasWidth * fontAtlasHeight, 0);
+    for (int glyph = 0; glyph < fontGlyphCount; ++glyph) {
+        for (int row = 0; row < 7; ++row) {
+            for (int column = 0; column < 5; ++column) {
+                if (fontGlyphs[glyph][row] & (0x10 >> column)) {
+                    atlas[row * fontAtlasWidth + glyph * textCellWidth + column] = 255;
+                }
+            }
+        }
+    }
+    for (int row = 0; row < fontAtlasHeight; ++row) {
+        for (int column = 0; column < textCellWidth; ++column) {
+            atlas[row * fontAtlasWidth + fontGlyphCount * textCellWidth + column] = 255;
+        }
+    }
+    
+    glGenTextures(1, &overlay.fontTexture);
+    glBindTexture(GL_TEXTURE_2D, overlay.fontTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, fontAtlasWidth, fontAtlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    glGenVertexArrays(1, &overlay.VAO);
+    glGenBuffers(1, &overlay.VBO);
+    glBindVertexArray(overlay.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, overlay.VBO);
+    GLsizei stride = vertexFloats * sizeof(float);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void destroyTextOverlay(TextOverlay& overlay) {
+    glDeleteVertexArrays(1, &overlay.VAO);
+    glDeleteBuffers(1, &overlay.VBO);
+    glDeleteTextures(1, &overlay.fontTexture);
+    overlay = TextOverlay();
+}
+
+void clearText(TextOverlay& overlay) {
+    overlay.vertices.clear();
+}
+
+// Two triangles covering the screen rectangle at (x, y) and the atlas
+// rectangle at (u, v), both given as top-left corner and size
+static void addQuad(TextOverlay& overlay, float x, float y, float width, float height,
+                    float u, float v, float uSize, float vSize, const glm::vec4& color) {
+    const float corners[6][2] = {{0, 0}, {1, 0}, {0, 1}, {1, 0}, {1, 1}, {0, 1}};
+    for (const auto& corner : corners) {
+        const float vertex[vertexFloats] = {
+            x + corner[0] * width, y + corner[1] * height,
+            (u + corner[0] * uSize) / fontAtlasWidth, (v + corner[1] * vSize) / fontAtlasHeight,
+            color.r, color.g, color.b, color.a};
+        overlay.vertices.insert(overlay.vertices.end(), vertex, vertex + vertexFloats);
+    }
+}
+
+void addText(TextOverlay& overlay, float x, float y, float scale, const std::string& text, const glm::vec4& color) {
+    float cursor = x;
+    for (char c : text) {
+        if (c >= 'a' && c <= 'z') c = c - 'a' + 'A';
+        if (c < ' ' || c > '_') c = '?';
+        if (c != ' ') {
+            float u = (float)((c - ' ') * textCellWidth);
+            addQuad(overlay, cursor, y, textCellWidth * scale, textCellHeight * scale,
+                    u, 0.0f, (float)textCellWidth, (float)textCellHeight, color);
+        }
+        cursor += textCellWidth * scale;
+    }
+}
+
+void addTextPanel(TextOverlay& overlay, float x, float y, float width, float height, const glm::vec4& color) {
+    // Sample only the middle of the solid cell so filtering never reaches a glyph
+    float u = fontGlyphCount * textCellWidth + textCellWidth * 0.5f;
+    float v = textCellHeight * 0.5f;
+    addQuad(overlay, x, y, width, height, u, v, 0.0f, 0.0f, color);
+}
+
+size_t uploadText(TextOverlay& overlay) {
+    TRACE_ZONE("uploadText");
+    size_t bytes = overlay.vertices.size() * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, overlay.VBO);
+    glBufferData(GL_ARRAY_BUFFER, bytes, overlay.vertices.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    overlay.vertexCount = (int)(overlay.vertices.size() / vertexFloats);
+    return bytes;
+}
+
+void drawTextOverlay(RenderQueue& queue, GLStateCache& cache, unsigned int program, const TextOverlay& overlay) {
+    if (overlay.vertexCount == 0) return;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, overlay.fontTexture);
+    
+    DrawItem item;
+    item.key = makeSortKey(LayerOverlay, program, overlay.VAO);
+    item.program = program;
+    item.vertexArray = overlay.VAO;
+    item.primitive = GL_TRIANGLES;
+    item.count = overlay.vertexCount;
+    submitDraw(queue, item);
+    
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    flushRenderQueue(queue, cache);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+}
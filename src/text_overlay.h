@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../include/glad/glad.h"
+#include "../include/glm/glm.hpp"
+#include "render_queue.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Screen-space text in a built-in 5x7 bitmap font, for debug overlays.
+//
+// Text is laid out on the CPU into textured quads (pixel coordinates from
+// the window's top-left corner) and uploaded only when it changes, so an
+// unchanged overlay costs one draw call and no uploads. Lowercase letters
+// are drawn as capitals; characters outside ' '..'_' are drawn as '?'.
+struct TextOverlay {
+    unsigned int VAO = 0, VBO = 0;
+    unsigned int fontTexture = 0;
+    std::vector<float> vertices;    // Layout being built
+    int vertexCount = 0;            // Vertices in the uploaded buffer
+};
+
+// Font pixels per glyph cell, including one pixel of spacing
+const int textCellWidth = 6;
+const int textCellHeight = 9;
+
+void createTextOverlay(TextOverlay& overlay);
+void destroyTextOverlay(TextOverlay& overlay);
+
+// Start a new layout; the previous one keeps drawing until uploadText
+void clearText(TextOverlay& overlay);
+
+// One line of text at (x, y), drawn `scale` screen pixels per font pixel
+void addText(TextOverlay& overlay, float x, float y, float scale, const std::string& text, const glm::vec4& color);
+
+// Solid rectangle, e.g. a translucent panel behind the text
+void addTextPanel(TextOverlay& overlay, float x, float y, float width, float height, const glm::vec4& color);
+
+// Upload the layout built since clearText. Returns the bytes uploaded.
+size_t uploadText(TextOverlay& overlay);
+
+// Alpha-blend the uploaded text over the frame. `program` must be the text
+// program with its viewportSize uniform set for the current window size.
+void drawTextOverlay(RenderQueue& queue, GLStateCache& cache, unsigned int program, const TextOverlay& overlay);
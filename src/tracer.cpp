@@ -0,0 +1,172 @@
+#include "tracer.h"
+#include <iostream>
+
+#ifdef PSIM_TRACING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fields are relaxed atomics so the exporter may read a slot while its
+// owner rewrites it; on x86 these are plain loads and stores
+struct TraceEvent {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> begin{0};
+    std::atomic<uint64_t> end{0};
+};
+
+// One thread's ring. Only the owning thread writes it; `written` counts
+// every zone ever recorded and is published with release ordering, so the
+// exporter sees complete slots up to it.
+struct TraceThreadBuffer {
+    TraceEvent events[traceRingSize];
+    std::atomic<uint64_t> written{0};
+    std::atomic<const char*> threadName{nullptr};
+    int threadId = 0;
+};
+
+// Every buffer ever handed out, one per thread that recorded a zone. Buffers
+// outlive their threads, so a thread that exits keeps its track. Threads
+// are few and long-lived (the parallelFor workers are a persistent pool).
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceThreadBuffer>> buffers;
+};
+
+static TraceRegistry& traceRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+// Timestamps become microseconds by comparing the counter against the
+// steady clock between this point and the export. Assumes an invariant TSC,
+// which every x86 CPU of the last decade has.
+struct TraceClockOrigin {
+    uint64_t ticks;
+    std::chrono::steady_clock::time_point time;
+};
+
+static const TraceClockOrigin traceOrigin = {traceTimestamp(), std::chrono::steady_clock::now()};
+
+static thread_local TraceThreadBuffer* traceThreadBuffer = nullptr;
+
+// Only the first zone on each thread takes the registry lock
+static TraceThreadBuffer* acquireThreadBuffer() {
+    TraceRegistry& registry = traceRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.buffers.emplace_back(new TraceThreadBuffer());
+    traceThreadBuffer = registry.buffers.back().get();
+    traceThreadBuffer->threadId = (int)registry.buffers.size();
+    return traceThreadBuffer;
+}
+
+void traceRecord(const char* name, uint64_t begin, uint64_t end) {
+    TraceThreadBuffer* buffer = traceThreadBuffer;
+    if (!buffer) buffer = acquireThreadBuffer();
+
+    uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[index % traceRingSize];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void traceThreadName(const char* name) {
+    TraceThreadBuffer* buffer = traceThreadBuffer;
+    if (!buffer) buffer = acquireThreadBuffer();
+    buffer->threadName.store(name, std::memory_order_relaxed);
+}
+
+struct TraceEventCopy {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Copy the ring's live zones, dropping any its owner overwrote meanwhile
+static void copyThreadEvents(const TraceThreadBuffer& buffer, std::vector<TraceEventCopy>& out) {
+    out.clear();
+    uint64_t last = buffer.written.load(std::memory_order_acquire);
+    uint64_t first = last > traceRingSize ? last - traceRingSize : 0;
+    for (uint64_t index = first; index < last; ++index) {
+        const TraceEvent& event = buffer.events[index % traceRingSize];
+        out.push_back({event.name.load(std::memory_order_relaxed),
+                       event.begin.load(std::memory_order_relaxed),
+                       event.end.load(std::memory_order_relaxed)});
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // The owner may be writing slot `now` already, which holds zone
+    // now - traceRingSize, so only zones after that one are certainly intact
+    uint64_t now = buffer.written.load(std::memory_order_relaxed);
+    uint64_t firstIntact = now + 1 > traceRingSize ? now + 1 - traceRingSize : 0;
+    if (firstIntact > first) {
+        size_t torn = (size_t)std::min(firstIntact - first, (uint64_t)out.size());
+        out.erase(out.begin(), out.begin() + torn);
+    }
+}
+
+long writeChromeTrace(const char* path) {
+    FILE* file = std::fopen(path, "w");
+    if (!file) {
+        std::cerr << "ERROR: Could not write trace file " << path << std::endl;
+        return -1;
+    }
+
+    double elapsedMicroseconds = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - traceOrigin.time).count();
+    double elapsedTicks = (double)(traceTimestamp() - traceOrigin.ticks);
+    double microsecondsPerTick = elapsedTicks > 0.0 ? elapsedMicroseconds / elapsedTicks : 0.0;
+    auto toMicroseconds = [&](uint64_t ticks) {
+        return ((double)ticks - (double)traceOrigin.ticks) * microsecondsPerTick;
+    };
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"PhysicsSim\"}}");
+
+    long zoneCount = 0;
+    std::vector<TraceEventCopy> events;
+    TraceRegistry& registry = traceRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const std::unique_ptr<TraceThreadBuffer>& buffer : registry.buffers) {
+        const char* threadName = buffer->threadName.load(std::memory_order_relaxed);
+        if (threadName) {
+            std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                         buffer->threadId, threadName);
+        } else {
+            std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}",
+                         buffer->threadId, buffer->threadId);
+        }
+
+        copyThreadEvents(*buffer, events);
+        for (const TraceEventCopy& event : events) {
+            double begin = toMicroseconds(event.begin);
+            double duration = (double)(event.end - event.begin) * microsecondsPerTick;
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                         event.name, buffer->threadId, begin, duration);
+        }
+        zoneCount += (long)events.size();
+    }
+    std::fprintf(file, "\n]}\n");
+
+    bool failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed) {
+        std::cerr << "ERROR: Failed writing trace file " << path << std::endl;
+        return -1;
+    }
+    return zoneCount;
+}
+
+#else
+
+long writeChromeTrace(const char* path) {
+    std::cerr << "ERROR: Cannot write " << path << ": tracing is not compiled in (build with make TRACE=1)" << std::endl;
+    return -1;
+}
+
+#endif
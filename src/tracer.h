@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+// Scoped-zone tracer for looking at individual frames and steps on a
+// timeline, where the profiler's rolling averages hide the outliers.
+//
+// TRACE_ZONE("name") records the time from that line to the end of the
+// enclosing scope. Zones nest, and each thread records into its own ring
+// buffer, so recording never takes a lock: a zone costs two timestamp reads
+// and one write into memory only this thread touches. Every thread keeps
+// its most recent traceRingSize zones; writeChromeTrace exports them as
+// Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.
+//
+// Tracing is compiled in only with PSIM_TRACING defined (make TRACE=1).
+// Without it the macros expand to nothing and zones cost nothing.
+//
+// Zone and thread names must be string literals: only the pointer is kept.
+
+// Zones kept per thread; older ones are overwritten
+const uint32_t traceRingSize = 1 << 16;
+
+#ifdef PSIM_TRACING
+
+const bool tracingEnabled = true;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+inline uint64_t traceTimestamp() { return __rdtsc(); }
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+inline uint64_t traceTimestamp() { return __rdtsc(); }
+#else
+#include <chrono>
+inline uint64_t traceTimestamp() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+#endif
+
+// Append one finished zone to the calling thread's ring
+void traceRecord(const char* name, uint64_t begin, uint64_t end);
+
+// Label the calling thread's track in the exported trace
+void traceThreadName(const char* name);
+
+struct TraceZone {
+    const char* name;
+    uint64_t begin;
+
+    explicit TraceZone(const char* name) : name(name), begin(traceTimestamp()) {}
+    ~TraceZone() { traceRecord(name, begin, traceTimestamp()); }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+
+#else
+
+const bool tracingEnabled = false;
+
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
+
+// Write every thread's recorded zones to `path` as Chrome trace JSON. Safe
+// to call while other threads keep recording. Returns the number of zones
+// written, or -1 on failure (including builds without PSIM_TRACING).
+long writeChromeTrace(const char* path);
@@ -0,0 +1,95 @@
+#include "trails.h"
+#include "tracer.h"
+#include <algorithm>
+#include <iostream>
+
+static void createBufferTexture(unsigned int& buffer, unsigned int& texture, size_t size, const void* data) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, size, data, data ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+bool createTrailBuffer(TrailBuffer& trails, const RenderBodies& bodies) {
+    trails.bodyCount = bodies.size();
+    if (trails.bodyCount == 0) return false;
+
+    size_t slotBytes = trails.bodyCount * 4 * sizeof(float);
+    trails.length = (int)std::min<size_t>(trailLength, trailMaxBytes / slotBytes);
+    if (trails.length < 2) {
+        std::cerr << "ERROR: Too many bodies for trails: " << trails.bodyCount << std::endl;
+        trails.length = 0;
+        return false;
+    }
+
+    int maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if ((size_t)trails.length * trails.bodyCount > (size_t)maxTexels) {
+        trails.length = (int)(maxTexels / trails.bodyCount);
+        if (trails.length < 2) {
+            std::cerr << "ERROR: Trail history exceeds the buffer texture limit" << std::endl;
+            trails.length = 0;
+            return false;
+        }
+    }
+
+    std::vector<float> colors(trails.bodyCount * 4);
+    for (size_t i = 0; i < trails.bodyCount; ++i) {
+        colors[i * 4] = bodies.color[i].x;
+        colors[i * 4 + 1] = bodies.color[i].y;
+        colors[i * 4 + 2] = bodies.color[i].z;
+        colors[i * 4 + 3] = 1.0f;
+    }
+    createBufferTexture(trails.colorBuffer, trails.colorTexture, colors.size() * sizeof(float), colors.data());
+    createBufferTexture(trails.positionBuffer, trails.positionTexture, slotBytes * trails.length, nullptr);
+
+    trails.staging.resize(trails.bodyCount * 4);
+    resetTrails(trails);
+    return true;
+}
+
+void destroyTrailBuffer(TrailBuffer& trails) {
+    glDeleteTextures(1, &trails.positionTexture);
+    glDeleteTextures(1, &trails.colorTexture);
+    glDeleteBuffers(1, &trails.positionBuffer);
+    glDeleteBuffers(1, &trails.colorBuffer);
+    trails = TrailBuffer();
+}
+
+void resetTrails(TrailBuffer& trails) {
+    trails.head = trails.length - 1;
+    trails.filled = 0;
+    trails.lastSample = -1.0e30;
+}
+
+size_t appendTrailSample(TrailBuffer& trails, const RenderBodies& bodies, double time) {
+    if (trails.length == 0 || bodies.size() != trails.bodyCount) return 0;
+    if (time - trails.lastSample < trailSampleInterval) return 0;
+    trails.lastSample = time;
+    TRACE_ZONE("appendTrailSample");
+
+    float* out = trails.staging.data();
+    for (size_t i = 0; i < trails.bodyCount; ++i) {
+        out[0] = bodies.x[i];
+        out[1] = bodies.y[i];
+        out[2] = bodies.z[i];
+        out[3] = 1.0f;
+        out += 4;
+    }
+
+    // Only the newest slot is written; older samples stay where they are
+    trails.head = (trails.head + 1) % trails.length;
+    trails.filled = std::min(trails.filled + 1, trails.length);
+
+    size_t slotBytes = trails.staging.size() * sizeof(float);
+    glBindBuffer(GL_TEXTURE_BUFFER, trails.positionBuffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, (GLintptr)(trails.head * slotBytes), slotBytes, trails.staging.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return slotBytes;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../include/glad/glad.h"
+#include "render_bodies.h"
+#include <cstddef>
+#include <vector>
+
+// Orbit trail history kept on the GPU.
+//
+// The history is a ring of `length` slots; each slot holds one vec4
+// position per body, so a slot is contiguous and appending a sample is a
+// single glBufferSubData of bodyCount positions. The trail vertex shader
+// walks back from `head` by gl_VertexID to find a body's older samples, and
+// every trail is drawn by one instanced GL_LINE_STRIP call (one instance per
+// body). Body colors live in a second buffer texture written once.
+struct TrailBuffer {
+    unsigned int positionBuffer = 0, positionTexture = 0;
+    unsigned int colorBuffer = 0, colorTexture = 0;
+    size_t bodyCount = 0;
+    int length = 0;         // Slots in the ring
+    int head = 0;           // Slot holding the newest sample
+    int filled = 0;         // Slots written since the last reset
+    double lastSample = 0.0;
+
+    std::vector<float> staging;
+};
+
+// Samples per trail, and how often one is taken
+const int trailLength = 128;
+const double trailSampleInterval = 1.0 / 30.0;
+
+// History is capped at this many bytes; long trails on huge scenes get shorter
+const size_t trailMaxBytes = 256u << 20;
+
+// Allocate history for `bodies` (their colors are written here). Returns
+// false if the trails could not be created.
+bool createTrailBuffer(TrailBuffer& trails, const RenderBodies& bodies);
+void destroyTrailBuffer(TrailBuffer& trails);
+
+// Forget the history, e.g. after a replay seek
+void resetTrails(TrailBuffer& trails);
+
+// Append the bodies' current positions if a sample is due at `time`.
+// Returns the bytes uploaded (0 if no sample was taken).
+size_t appendTrailSample(TrailBuffer& trails, const RenderBodies& bodies, double time);
@@ -0,0 +1,194 @@
+#include "trajectory.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+static const char trajectoryMagic[8] = {'P', 'S', 'I', 'M', 'T', 'R', 'J', '1'};
+static const uint32_t trajectoryVersion = 1;
+
+static uint64_t alignTo8(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+static bool writePadding(std::FILE* file, uint64_t from, uint64_t to) {
+    static const char zeros[8] = {};
+    return to == from || std::fwrite(zeros, 1, (size_t)(to - from), file) == (size_t)(to - from);
+}
+
+bool openTrajectoryWriter(TrajectoryWriter& writer, const char* path, const BodyList& bodies) {
+    writer.file = std::fopen(path, "wb");
+    if (!writer.file) {
+        std::cerr << "ERROR: Could not create trajectory file " << path << std::endl;
+        return false;
+    }
+    writer.bodyCount = (uint32_t)bodies.size();
+    writer.frameTimes.clear();
+    writer.frameScratch.resize(bodies.size() * 3);
+    
+    // Placeholder header, rewritten by closeTrajectoryWriter once the counts are known
+    TrajectoryHeader header = {};
+    std::memcpy(header.magic, trajectoryMagic, sizeof(header.magic));
+    std::fwrite(&header, sizeof(header), 1, writer.file);
+    
+    for (const SpherePhysics& body : bodies) {
+        TrajectoryBody record = {body.radius, {body.color.x, body.color.y, body.color.z}};
+        std::fwrite(&record, sizeof(record), 1, writer.file);
+    }
+    
+    if (std::ferror(writer.file)) {
+        std::cerr << "ERROR: Failed writing trajectory file " << path << std::endl;
+        std::fclose(writer.file);
+        writer.file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool appendTrajectoryFrame(TrajectoryWriter& writer, const BodyList& bodies, double time) {
+    if (!writer.file || bodies.size() != writer.bodyCount) return false;
+    
+    float* out = writer.frameScratch.data();
+    for (const SpherePhysics& body : bodies) {
+        *out++ = body.position.x;
+        *out++ = body.position.y;
+        *out++ = body.position.z;
+    }
+    size_t floatCount = writer.frameScratch.size();
+    if (std::fwrite(writer.frameScratch.data(), sizeof(float), floatCount, writer.file) != floatCount) {
+        std::cerr << "ERROR: Failed writing trajectory frame" << std::endl;
+        return false;
+    }
+    writer.frameTimes.push_back(time);
+    return true;
+}
+
+bool closeTrajectoryWriter(TrajectoryWriter& writer) {
+    if (!writer.file) return false;
+    
+    TrajectoryHeader header = {};
+    std::memcpy(header.magic, trajectoryMagic, sizeof(header.magic));
+    header.version = trajectoryVersion;
+    header.bodyCount = writer.bodyCount;
+    header.frameCount = writer.frameTimes.size();
+    header.framesOffset = sizeof(TrajectoryHeader) + (uint64_t)writer.bodyCount * sizeof(TrajectoryBody);
+    uint64_t framesEnd = header.framesOffset + header.frameCount * writer.bodyCount * 3 * sizeof(float);
+    header.timesOffset = alignTo8(framesEnd);
+    header.seekOffset = header.timesOffset + header.frameCount * sizeof(double);
+    
+    // One seek bucket per average frame interval, so each lookup lands on
+    // (or within a frame or two of) the frame it is looking for
+    double startTime = header.frameCount ? writer.frameTimes.front() : 0.0;
+    header.duration = header.frameCount ? writer.frameTimes.back() - startTime : 0.0;
+    header.seekInterval = header.frameCount > 1 ? header.duration / (double)(header.frameCount - 1) : 1.0;
+    if (header.seekInterval <= 0.0) header.seekInterval = 1.0;
+    header.seekCount = (uint64_t)std::floor(header.duration / header.seekInterval) + 1;
+    
+    std::vector<uint64_t> seekIndex(header.seekCount);
+    uint64_t frame = 0;
+    for (uint64_t k = 0; k < header.seekCount; ++k) {
+        double bucketStart = startTime + (double)k * header.seekInterval;
+        while (frame + 1 < header.frameCount && writer.frameTimes[frame] < bucketStart) frame++;
+        seekIndex[k] = frame;
+    }
+    
+    bool ok = writePadding(writer.file, framesEnd, header.timesOffset);
+    ok = ok && std::fwrite(writer.frameTimes.data(), sizeof(double), writer.frameTimes.size(), writer.file) == writer.frameTimes.size();
+    ok = ok && std::fwrite(seekIndex.data(), sizeof(uint64_t), seekIndex.size(), writer.file) == seekIndex.size();
+    ok = ok && std::fseek(writer.file, 0, SEEK_SET) == 0;
+    ok = ok && std::fwrite(&header, sizeof(header), 1, writer.file) == 1;
+    ok = std::fclose(writer.file) == 0 && ok;
+    writer.file = nullptr;
+    
+    if (!ok) {
+        std::cerr << "ERROR: Failed finalizing trajectory file" << std::endl;
+    }
+    return ok;
+}
+
+bool openTrajectoryReader(TrajectoryReader& reader, const char* path) {
+    if (!openMappedFile(reader.file, path)) return false;
+    
+    const TrajectoryHeader* header = reinterpret_cast<const TrajectoryHeader*>(reader.file.data);
+    uint64_t size = reader.file.size;
+    bool valid = size >= sizeof(TrajectoryHeader)
+        && std::memcmp(header->magic, trajectoryMagic, sizeof(trajectoryMagic)) == 0
+        && header->version == trajectoryVersion
+        && header->frameCount > 0;
+    if (valid) {
+        // Every count comes from the file, so bound each region against the
+        // mapping size by division before multiplying anything out
+        uint64_t frameBytes = (uint64_t)header->bodyCount * 3 * sizeof(float);
+        uint64_t bodiesEnd = sizeof(TrajectoryHeader) + (uint64_t)header->bodyCount * sizeof(TrajectoryBody);
+        valid = header->framesOffset == bodiesEnd
+            && bodiesEnd <= size
+            && (frameBytes == 0 || header->frameCount <= (size - bodiesEnd) / frameBytes);
+        valid = valid
+            && header->timesOffset >= header->framesOffset + header->frameCount * frameBytes
+            && header->timesOffset % 8 == 0
+            && header->timesOffset <= size
+            && header->frameCount <= (size - header->timesOffset) / sizeof(double);
+        valid = valid
+            && header->seekOffset == header->timesOffset + header->frameCount * sizeof(double)
+            && header->seekCount > 0
+            && header->seekCount <= (size - header->seekOffset) / sizeof(uint64_t)
+            && std::isfinite(header->seekInterval)
+            && header->seekInterval > 0.0;
+    }
+    if (valid) {
+        // findTrajectoryFrame indexes the frame times straight from these
+        const uint64_t* seekIndex = reinterpret_cast<const uint64_t*>(reader.file.data + header->seekOffset);
+        for (uint64_t k = 0; k < header->seekCount && valid; ++k) {
+            valid = seekIndex[k] < header->frameCount;
+        }
+    }
+    if (!valid) {
+        std::cerr << "ERROR: " << path << " is not a valid trajectory file" << std::endl;
+        closeMappedFile(reader.file);
+        return false;
+    }
+    
+    reader.header = header;
+    reader.bodies = reinterpret_cast<const TrajectoryBody*>(reader.file.data + sizeof(TrajectoryHeader));
+    reader.frames = reinterpret_cast<const float*>(reader.file.data + header->framesOffset);
+    reader.times = reinterpret_cast<const double*>(reader.file.data + header->timesOffset);
+    reader.seekIndex = reinterpret_cast<const uint64_t*>(reader.file.data + header->seekOffset);
+    return true;
+}
+
+void closeTrajectoryReader(TrajectoryReader& reader) {
+    closeMappedFile(reader.file);
+    reader = TrajectoryReader();
+}
+
+uint64_t findTrajectoryFrame(const TrajectoryReader& reader, double time) {
+    const TrajectoryHeader& header = *reader.header;
+    if (time <= 0.0) return 0;
+    
+    // Compare before converting: a far-off time does not fit in a uint64_t
+    double buckets = time / header.seekInterval;
+    if (!(buckets < (double)header.seekCount)) return header.frameCount - 1;
+    uint64_t bucket = (uint64_t)buckets;
+    
+    // The bucket points at the first frame at or after its start time; step
+    // back if that overshoots, then forward over any frames still before `time`
+    double target = reader.times[0] + time;
+    uint64_t frame = reader.seekIndex[bucket];
+    while (frame > 0 && reader.times[frame] > target) frame--;
+    while (frame + 1 < header.frameCount && reader.times[frame + 1] <= target) frame++;
+    return frame;
+}
+
+const float* trajectoryFramePositions(const TrajectoryReader& reader, uint64_t frame) {
+    const TrajectoryHeader& header = *reader.header;
+    if (frame >= header.frameCount) frame = header.frameCount - 1;
+    
+    uint64_t frameFloats = (uint64_t)header.bodyCount * 3;
+    const float* positions = reader.frames + frame * frameFloats;
+    
+    // Let the OS start reading the following frame while this one is drawn
+    if (frame + 1 < header.frameCount) {
+        prefetchMappedRange(reader.file, header.framesOffset + (frame + 1) * frameFloats * sizeof(float),
+                            frameFloats * sizeof(float));
+    }
+    return positions;
+}
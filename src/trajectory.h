@@ -0,0 +1,61 @@
+#pragma once
+
+#include "physics.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Recorded trajectory file layout:
+//   TrajectoryHeader
+//   bodyCount  x TrajectoryBody            (radius and color, written once)
+//   frameCount x bodyCount x float[3]      (positions, fixed stride per frame)
+//   frameCount x double                    (simulation time of each frame)
+//   seekCount  x uint64_t                  (first frame at or after k * seekInterval)
+// Frames have a fixed stride, so once the seek index has mapped a time to a
+// frame number the frame itself is a single pointer offset.
+struct TrajectoryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bodyCount;
+    uint64_t frameCount;
+    uint64_t framesOffset;
+    uint64_t timesOffset;
+    uint64_t seekOffset;
+    uint64_t seekCount;
+    double seekInterval;
+    double duration;
+};
+
+struct TrajectoryBody {
+    float radius;
+    float color[3];
+};
+
+struct TrajectoryWriter {
+    std::FILE* file = nullptr;
+    uint32_t bodyCount = 0;
+    std::vector<double> frameTimes;
+    std::vector<float> frameScratch;
+};
+
+struct TrajectoryReader {
+    MappedFile file;
+    const TrajectoryHeader* header = nullptr;
+    const TrajectoryBody* bodies = nullptr;
+    const float* frames = nullptr;
+    const double* times = nullptr;
+    const uint64_t* seekIndex = nullptr;
+};
+
+bool openTrajectoryWriter(TrajectoryWriter& writer, const char* path, const BodyList& bodies);
+bool appendTrajectoryFrame(TrajectoryWriter& writer, const BodyList& bodies, double time);
+// Writes the frame times and seek index, then finalizes the header
+bool closeTrajectoryWriter(TrajectoryWriter& writer);
+
+bool openTrajectoryReader(TrajectoryReader& reader, const char* path);
+void closeTrajectoryReader(TrajectoryReader& reader);
+
+// Last frame recorded at or before `time` seconds into the recording (clamped)
+uint64_t findTrajectoryFrame(const TrajectoryReader& reader, double time);
+const float* trajectoryFramePositions(const TrajectoryReader& reader, uint64_t frame);
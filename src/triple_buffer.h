@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer, single-consumer handoff of whole snapshots.
+//
+// The writer fills the back slot and publishes it by swapping it with the
+// middle slot; the reader swaps the middle slot with its front slot whenever
+// a newer snapshot is waiting. Neither side ever waits for the other: the
+// writer can publish faster than the reader consumes (older snapshots are
+// simply overwritten) and the reader keeps its front slot for as long as it
+// needs it.
+template <typename T>
+struct TripleBuffer {
+    T slots[3];
+
+    // Index of the middle slot, plus tripleBufferFresh when it holds a
+    // snapshot the reader has not taken yet
+    std::atomic<uint8_t> middle{1};
+
+    uint8_t back = 0;   // Owned by the writer
+    uint8_t front = 2;  // Owned by the reader
+};
+
+const uint8_t tripleBufferIndexMask = 0x3;
+const uint8_t tripleBufferFresh = 0x4;
+
+// Slot the writer fills before calling publishSnapshot. It holds whatever
+// snapshot was last swapped out, so callers rewrite it completely.
+template <typename T>
+T& snapshotWriteSlot(TripleBuffer<T>& buffer) {
+    return buffer.slots[buffer.back];
+}
+
+template <typename T>
+void publishSnapshot(TripleBuffer<T>& buffer) {
+    uint8_t previous = buffer.middle.exchange(buffer.back | tripleBufferFresh, std::memory_order_acq_rel);
+    buffer.back = previous & tripleBufferIndexMask;
+}
+
+// Take the newest published snapshot, if there is one the reader has not
+// seen. Returns false (and leaves the front slot alone) otherwise.
+template <typename T>
+bool consumeSnapshot(TripleBuffer<T>& buffer) {
+    if (!(buffer.middle.load(std::memory_order_acquire) & tripleBufferFresh)) return false;
+    uint8_t previous = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel);
+    buffer.front = previous & tripleBufferIndexMask;
+    return true;
+}
+
+template <typename T>
+const T& snapshotReadSlot(const TripleBuffer<T>& buffer) {
+    return buffer.slots[buffer.front];
+}
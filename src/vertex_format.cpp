@@ -0,0 +1,24 @@
+#include "vertex_format.h"
+#include "../include/glad/glad.h"
+#include "../include/glm/gtc/packing.hpp"
+#include "mesh_gen.h"
+
+void packMeshVertices(const float* vertices, size_t vertexCount, std::vector<PackedMeshVertex>& out) {
+    out.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float* in = vertices + v * meshVertexFloats;
+        uint64_t position = glm::packHalf4x16(glm::vec4(in[0], in[1], in[2], 0.0f));
+        for (int c = 0; c < 4; ++c) {
+            out[v].position[c] = (uint16_t)(position >> (16 * c));
+        }
+        out[v].normal = glm::packSnorm3x10_1x2(glm::vec4(glm::normalize(glm::vec3(in[3], in[4], in[5])), 0.0f));
+    }
+}
+
+void setupPackedMeshAttributes() {
+    GLsizei stride = sizeof(PackedMeshVertex);
+    glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedMeshVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedMeshVertex, normal));
+    glEnableVertexAttribArray(1);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../include/glm/glm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compact vertex and instance layouts. Software rasterizers in particular
+// spend much of their time fetching attributes, so every byte per vertex and
+// per instance counts once there are many thousands of instances.
+
+// Mesh vertex, 12 bytes instead of 24: a unit-sphere position as three
+// half floats (about 3 decimal digits, plenty within [-1, 1]) plus padding
+// to keep the normal 4-byte aligned, and the normal as signed-normalized
+// 10:10:10:2 (GL_INT_2_10_10_10_REV)
+struct PackedMeshVertex {
+    uint16_t position[4];
+    uint32_t normal;
+};
+static_assert(sizeof(PackedMeshVertex) == 12, "PackedMeshVertex must stay tightly packed");
+
+// Sphere instance, 20 bytes instead of 28. World positions need full float
+// precision far from the origin, so only the color is quantized (RGBA8).
+// The alpha channel carries the emissive weight: stars glow at full color.
+struct SphereInstance {
+    float x, y, z;
+    float radius;
+    uint32_t color;
+};
+static_assert(sizeof(SphereInstance) == 20, "SphereInstance must stay tightly packed");
+
+// Pack meshVertexFloats-float vertices (position, normal) from mesh_gen
+void packMeshVertices(const float* vertices, size_t vertexCount, std::vector<PackedMeshVertex>& out);
+
+// Point locations 0 (position) and 1 (normal) of the bound VAO at the
+// PackedMeshVertex data in the bound GL_ARRAY_BUFFER
+void setupPackedMeshAttributes();